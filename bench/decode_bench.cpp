@@ -0,0 +1,128 @@
+/*
+ *  Benchmarks do motor sobre os clipes sintéticos: abertura, frame n em
+ *  várias profundidades (linear e com seek pelo índice) e gravação.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+#include "get_frame.hpp"
+#include "synth_video.hpp"
+
+namespace {
+
+// frames/s e ns/frame a partir dos frames decodificados no laço.
+void report(benchmark::State& st, std::size_t frames_per_iter)
+{
+    const double frames = static_cast<double>(st.iterations() * frames_per_iter);
+    st.SetItemsProcessed(static_cast<int64_t>(frames));
+    st.counters["frames/s"] = benchmark::Counter(frames, benchmark::Counter::kIsRate);
+    st.counters["ns/frame"] = benchmark::Counter(
+        frames * 1e-9, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void bench_open(benchmark::State& st, const Clip& clip)
+{
+    for (auto _ : st) {
+        VideoFile vf(clip.path);
+        if (!vf.open()) {
+            st.SkipWithError("open falhou");
+            return;
+        }
+        benchmark::DoNotOptimize(&vf);
+    }
+    st.SetItemsProcessed(st.iterations());
+}
+
+// Abre a cada iteração: sem seek, o custo de n é a decodificação de 0..n.
+void bench_get_nth(benchmark::State& st, const Clip& clip, std::size_t n)
+{
+    for (auto _ : st) {
+        VideoFile vf(clip.path);
+        if (!vf.open() || !get_nth_frame(vf, n)) {
+            st.SkipWithError("frame não encontrado");
+            return;
+        }
+    }
+    report(st, n + 1);
+}
+
+// Com índice: o custo passa a ser o do GOP do alvo.
+void bench_seek_nth(benchmark::State& st, const Clip& clip, std::size_t n,
+                    const FrameIndex& idx)
+{
+    VideoFile vf(clip.path);
+    vf.use_index(&idx);
+    if (!vf.open()) {
+        st.SkipWithError("open falhou");
+        return;
+    }
+    std::size_t decoded = 0;
+    for (auto _ : st) {
+        if (!seek_nth_frame(vf, n)) {
+            st.SkipWithError("frame não encontrado");
+            return;
+        }
+        decoded += n - idx[n].key + 1;   // já depois de n: o seek sempre volta
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(decoded));
+    st.counters["ns/frame"] = benchmark::Counter(
+        static_cast<double>(decoded) * 1e-9,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// Conversão e escrita de um frame já decodificado.
+void bench_save(benchmark::State& st, const Clip& clip, const std::string& out,
+                ScaleSpec scale)
+{
+    VideoFile vf(clip.path);
+    AVFrame* fr = vf.open() ? get_nth_frame(vf, 0) : nullptr;
+    if (!fr) {
+        st.SkipWithError("frame não encontrado");
+        return;
+    }
+    ImageWriter write(scale);
+    for (auto _ : st) write(fr, out);
+    report(st, 1);
+}
+
+} // namespace
+
+void register_decode_benchmarks(const std::vector<Clip>& clips, const std::string& dir)
+{
+    static std::vector<std::unique_ptr<FrameIndex>> indexes;   // vivos até o fim
+    for (const Clip& clip : clips) {
+        benchmark::RegisterBenchmark(("open/" + clip.name).c_str(), bench_open, clip)
+            ->Unit(benchmark::kMicrosecond);
+
+        const std::size_t last = static_cast<std::size_t>(clip.spec.frames - 1);
+        const std::size_t depths[] = {0, last / 4, last / 2, last};
+        for (std::size_t n : depths)
+            benchmark::RegisterBenchmark(
+                ("get_nth_frame/" + clip.name + '/' + std::to_string(n)).c_str(),
+                bench_get_nth, clip, n)->Unit(benchmark::kMillisecond);
+
+        auto idx = std::make_unique<FrameIndex>();
+        const std::string sidecar = index_path(clip.path);
+        if (FrameIndex::build(clip.path, sidecar) && idx->load(sidecar, clip.path)) {
+            for (std::size_t n : depths)
+                if (n < idx->size())
+                    benchmark::RegisterBenchmark(
+                        ("seek_nth_frame/" + clip.name + '/' + std::to_string(n)).c_str(),
+                        bench_seek_nth, clip, n, std::cref(*idx))
+                        ->Unit(benchmark::kMillisecond);
+            indexes.push_back(std::move(idx));
+        }
+
+        for (const char* ext : {".ppm", ".pgm"})
+            benchmark::RegisterBenchmark(("save/" + clip.name + ext).c_str(),
+                                         bench_save, clip, dir + "/out" + ext, ScaleSpec{})
+                ->Unit(benchmark::kMicrosecond);
+        ScaleSpec half;
+        half.width = clip.spec.width / 2;
+        benchmark::RegisterBenchmark(("save/" + clip.name + "_half.ppm").c_str(),
+                                     bench_save, clip, dir + "/out.ppm", half)
+            ->Unit(benchmark::kMicrosecond);
+    }
+}
@@ -0,0 +1,298 @@
+/*
+ *  get_frame_check: confere que os caminhos rápidos entregam o mesmo
+ *  frame que a decodificação linear. Gera clipes sintéticos (Matroska,
+ *  MP4 com e sem B-frames e MPEG-TS), decodifica cada um do começo ao
+ *  fim como referência e compara com seek_nth_frame (sem índice, que no
+ *  MPEG-TS bissecciona; sidecar; índice do contêiner; --fast) e com
+ *  pipeline_frames. Sai com 0 se tudo bate, 1 na primeira divergência
+ *  de cada caso e 77 (pulado) se nenhum encoder existir.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+
+#include <dirent.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include "get_frame.hpp"
+#include "synth_video.hpp"
+
+namespace {
+
+constexpr int skipped = 77;
+
+void remove_dir(const std::string& dir)
+{
+    if (DIR* d = ::opendir(dir.c_str())) {
+        while (dirent* e = ::readdir(d)) {
+            std::string name = e->d_name;
+            if (name != "." && name != "..") ::unlink((dir + '/' + name).c_str());
+        }
+        ::closedir(d);
+    }
+    ::rmdir(dir.c_str());
+}
+
+// Clipes pequenos que cobrem os contêineres com e sem tabela de amostras
+// e a reordenação por B-frames (max_b_frames 2 com GOP > 2). O MP4 sem
+// B-frames é o que tem índice do contêiner exato.
+std::vector<Clip> check_clips(const std::string& dir)
+{
+    struct Variant {
+        const char* codec;
+        int gop;
+        int b_frames;
+        const char* format;
+        const char* ext;
+    };
+    const Variant variants[] = {
+        {"libx264", 12,  -1, "matroska", ".mkv"},
+        {"libx264", 120, -1, "matroska", ".mkv"},
+        {"mpeg4",   12,  -1, "matroska", ".mkv"},
+        {"mjpeg",   1,   -1, "matroska", ".mkv"},
+        {"libx264", 12,  -1, "mp4",      ".mp4"},
+        {"mpeg4",   12,  -1, "mp4",      ".mp4"},
+        {"libx264", 12,  0,  "mp4",      ".mp4"},
+        {"mpeg4",   12,  0,  "mp4",      ".mp4"},
+        {"libx264", 24,  -1, "mpegts",   ".ts"},
+        {"mpeg4",   24,  -1, "mpegts",   ".ts"},
+    };
+    std::vector<Clip> clips;
+    for (const Variant& v : variants) {
+        ClipSpec spec{v.codec, 320, 240, v.gop, 240, v.format, v.b_frames};
+        std::string name = std::string(v.codec) + "_g" + std::to_string(v.gop) +
+                           (v.b_frames == 0 ? "_nob" : "") + v.ext;
+        std::string path = dir + '/' + name;
+        if (make_clip(spec, path)) clips.push_back(Clip{spec, path, name});
+    }
+    return clips;
+}
+
+// FNV-1a sobre as linhas visíveis de cada plano: ignora o padding.
+uint64_t frame_hash(const AVFrame* fr)
+{
+    const auto fmt = static_cast<AVPixelFormat>(fr->format);
+    const AVPixFmtDescriptor* d = av_pix_fmt_desc_get(fmt);
+    uint64_t h = 14695981039346656037ull;
+    for (int p = 0; p < 4 && fr->data[p]; ++p) {
+        const int bytes = av_image_get_linesize(fmt, fr->width, p);
+        const int rows = p == 1 || p == 2 ? AV_CEIL_RSHIFT(fr->height, d->log2_chroma_h)
+                                          : fr->height;
+        for (int y = 0; y < rows; ++y) {
+            const uint8_t* row = fr->data[p] + static_cast<std::ptrdiff_t>(y) * fr->linesize[p];
+            for (int x = 0; x < bytes; ++x) {
+                h ^= row[x];
+                h *= 1099511628211ull;
+            }
+        }
+    }
+    return h;
+}
+
+// Alvos: bordas de GOP, o começo, o fim e um passeio que vai e volta.
+std::vector<std::size_t> targets(const ClipSpec& spec)
+{
+    const std::size_t last = static_cast<std::size_t>(spec.frames - 1);
+    const std::size_t gop = static_cast<std::size_t>(spec.gop);
+    std::vector<std::size_t> ns = {last / 2, 0, 1, gop - 1, gop, gop + 1,
+                                   last, last - 1, 2 * gop + 5, gop + 3};
+    for (std::size_t i = 1; i <= 8; ++i) ns.push_back(i * 97 % (last + 1));
+    ns.erase(std::remove_if(ns.begin(), ns.end(), [&](std::size_t n) { return n > last; }),
+             ns.end());
+    return ns;
+}
+
+// Decodificação linear, a referência: um hash por frame, na ordem de
+// saída, e a imagem codificada dos alvos.
+struct Reference {
+    std::vector<uint64_t> hashes;
+    std::map<std::size_t, std::vector<uint8_t>> images;
+};
+
+bool decode_reference(const Clip& clip, const std::vector<std::size_t>& ns, Reference& ref)
+{
+    VideoFile vf(clip.path);
+    if (!vf.open()) return false;
+    ImageWriter write;
+    while (AVFrame* fr = vf.read()) {
+        if (vf.position() != ref.hashes.size()) return false;
+        ref.hashes.push_back(frame_hash(fr));
+        if (std::find(ns.begin(), ns.end(), vf.position()) != ns.end())
+            ref.images[vf.position()] = write.encode(fr, "ref.ppm");
+    }
+    return ref.hashes.size() == static_cast<std::size_t>(clip.spec.frames);
+}
+
+enum class IndexKind { none, sidecar, container, estimated };
+
+struct SeekMode {
+    const char* name;
+    IndexKind index;
+    bool fast;
+};
+
+// O sidecar vai antes de open(); false se o modo pede um e não há.
+bool load_index(const Clip& clip, IndexKind kind, FrameIndex& idx)
+{
+    return kind != IndexKind::sidecar || idx.load(index_path(clip.path), clip.path);
+}
+
+// O índice do contêiner vem do vf já aberto; false se o clipe não tem o
+// que o modo pede.
+bool container_index(IndexKind kind, FrameIndex& idx, VideoFile& vf)
+{
+    if (kind != IndexKind::container && kind != IndexKind::estimated) return true;
+    return vf.index_container(idx, kind == IndexKind::estimated);
+}
+
+void report(const Clip& clip, const char* mode, std::size_t n, const std::string& what)
+{
+    std::cerr << "DIVERGE " << clip.name << ' ' << mode << " frame " << n << ": "
+              << what << '\n';
+}
+
+// Um só VideoFile por modo, alvos fora de ordem: confere também o estado
+// que fica de um seek para o seguinte.
+bool check_seek(const Clip& clip, const SeekMode& m, const std::vector<std::size_t>& ns,
+                const Reference& ref)
+{
+    FrameIndex idx;
+    if (!load_index(clip, m.index, idx)) return true;
+    VideoFile vf(clip.path);
+    if (idx.loaded()) vf.use_index(&idx);
+    vf.fast_forward(m.fast);
+    if (!vf.open()) {
+        report(clip, m.name, 0, "open falhou");
+        return false;
+    }
+    if (!container_index(m.index, idx, vf)) return true;
+    for (std::size_t n : ns) {
+        AVFrame* fr = seek_nth_frame(vf, n);
+        if (!fr) {
+            report(clip, m.name, n, "frame não encontrado");
+            return false;
+        }
+        if (vf.position() != n) {
+            report(clip, m.name, n, "numerado como " + std::to_string(vf.position()));
+            return false;
+        }
+        if (frame_hash(fr) != ref.hashes[n]) {
+            report(clip, m.name, n, "pixels diferentes");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_pipeline(const Clip& clip, IndexKind kind, bool fast, const char* mode,
+                    const std::vector<std::size_t>& ns, const Reference& ref,
+                    const std::string& dir)
+{
+    FrameIndex idx;
+    if (!load_index(clip, kind, idx)) return true;
+    VideoFile vf(clip.path);
+    if (idx.loaded()) vf.use_index(&idx);
+    vf.fast_forward(fast);
+    if (!vf.open()) {
+        report(clip, mode, 0, "open falhou");
+        return false;
+    }
+    if (!container_index(kind, idx, vf)) return true;
+    std::vector<FrameRequest> reqs;
+    for (std::size_t i = 0; i < ns.size(); ++i)
+        reqs.push_back(FrameRequest{ns[i], dir + "/pipe_" + std::to_string(i) + ".ppm"});
+    reqs.push_back(FrameRequest{ns[0], dir + "/pipe_dup.ppm"});  // pedido repetido
+    std::stable_sort(reqs.begin(), reqs.end(),
+        [](const FrameRequest& a, const FrameRequest& b) { return a.frame < b.frame; });
+
+    ExtractResult r = pipeline_frames(vf, idx, reqs, ScaleSpec{});
+    bool ok = true;
+    if (r.failed != 0 || r.written != reqs.size()) {
+        report(clip, mode, 0, std::to_string(r.written) + " gravados, " +
+                              std::to_string(r.failed) + " falhas");
+        ok = false;
+    }
+    for (const FrameRequest& q : reqs) {
+        std::ifstream in(q.out, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)),
+                                   std::istreambuf_iterator<char>());
+        ::unlink(q.out.c_str());
+        if (ok && bytes != ref.images.at(q.frame)) {
+            report(clip, mode, q.frame, "imagem diferente");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+int main()
+{
+    av_log_set_level(AV_LOG_QUIET);
+
+    const char* tmp = std::getenv("TMPDIR");
+    std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/get_frame_check.XXXXXX";
+    if (!::mkdtemp(&dir[0])) {
+        std::cerr << "não consegui criar o diretório temporário\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<Clip> clips = check_clips(dir);
+    if (clips.empty()) {
+        std::cerr << "nenhum encoder disponível\n";
+        remove_dir(dir);
+        return skipped;
+    }
+
+    const SeekMode seeks[] = {
+        {"seek",                 IndexKind::none,      false},
+        {"seek+fast",            IndexKind::none,      true},
+        {"seek+sidecar",         IndexKind::sidecar,   false},
+        {"seek+sidecar+fast",    IndexKind::sidecar,   true},
+        {"seek+container",       IndexKind::container, false},
+        {"seek+estimated",       IndexKind::estimated, false},
+    };
+
+    int failures = 0, cases = 0;
+    for (const Clip& clip : clips) {
+        const std::vector<std::size_t> ns = targets(clip.spec);
+        Reference ref;
+        if (!decode_reference(clip, ns, ref)) {
+            report(clip, "linear", ref.hashes.size(), "referência incompleta");
+            ++failures;
+            continue;
+        }
+        if (!FrameIndex::build(clip.path, index_path(clip.path))) {
+            report(clip, "build-index", 0, "índice não gerado");
+            ++failures;
+        }
+        for (const SeekMode& m : seeks) {
+            ++cases;
+            if (!check_seek(clip, m, ns, ref)) ++failures;
+        }
+        for (bool fast : {false, true}) {
+            cases += 2;
+            if (!check_pipeline(clip, IndexKind::none, fast,
+                                fast ? "pipeline+fast" : "pipeline", ns, ref, dir))
+                ++failures;
+            if (!check_pipeline(clip, IndexKind::sidecar, fast,
+                                fast ? "pipeline+sidecar+fast" : "pipeline+sidecar",
+                                ns, ref, dir))
+                ++failures;
+        }
+    }
+    remove_dir(dir);
+
+    std::cout << clips.size() << " clipes, " << cases << " casos, " << failures
+              << " divergências\n";
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+/*
+ *  get_frame_bench: gera os clipes de teste num diretório temporário,
+ *  registra os benchmarks sobre eles e apaga tudo no fim.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <iostream>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "get_frame.hpp"
+#include "synth_video.hpp"
+
+namespace {
+
+void remove_dir(const std::string& dir)
+{
+    if (DIR* d = ::opendir(dir.c_str())) {
+        while (dirent* e = ::readdir(d)) {
+            std::string name = e->d_name;
+            if (name != "." && name != "..") ::unlink((dir + '/' + name).c_str());
+        }
+        ::closedir(d);
+    }
+    ::rmdir(dir.c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return EXIT_FAILURE;
+    av_log_set_level(AV_LOG_QUIET);
+
+    const char* tmp = std::getenv("TMPDIR");
+    std::string tmpl = std::string(tmp && *tmp ? tmp : "/tmp") + "/get_frame_bench.XXXXXX";
+    if (!::mkdtemp(&tmpl[0])) {
+        std::cerr << "não consegui criar o diretório temporário\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<Clip> clips = make_clips(tmpl);
+    if (clips.empty()) std::cerr << "nenhum encoder disponível: só os kernels de conversão\n";
+    register_decode_benchmarks(clips, tmpl);
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    remove_dir(tmpl);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/*
+ *  Gerador de clipes de teste com os encoders da libavcodec.
+ */
+
+#include "synth_video.hpp"
+
+#include "get_frame.hpp"
+
+namespace {
+
+// Dono dos contextos do encoder; libera tudo em qualquer saída.
+struct Encoder {
+    AVFormatContext* fmt{nullptr};
+    AVCodecContext* ctx{nullptr};
+    AVFrame* frame{nullptr};
+    AVPacket* pkt{nullptr};
+
+    ~Encoder()
+    {
+        av_packet_free(&pkt);
+        av_frame_free(&frame);
+        avcodec_free_context(&ctx);
+        if (fmt) {
+            if (fmt->pb) avio_closep(&fmt->pb);
+            avformat_free_context(fmt);
+        }
+    }
+};
+
+// Gradiente diagonal que anda e um bloco que cruza a tela: há movimento
+// para os quadros P/B, e o conteúdo depende só de i.
+void paint(AVFrame* fr, int i)
+{
+    const int w = fr->width, h = fr->height;
+    const int bx = (i * 7) % (w > 64 ? w - 64 : 1), by = (i * 3) % (h > 64 ? h - 64 : 1);
+    for (int y = 0; y < h; ++y) {
+        uint8_t* row = fr->data[0] + y * fr->linesize[0];
+        for (int x = 0; x < w; ++x) {
+            bool box = x >= bx && x < bx + 64 && y >= by && y < by + 64;
+            row[x] = box ? 235 : static_cast<uint8_t>(16 + ((x + y + 2 * i) & 127));
+        }
+    }
+    for (int y = 0; y < h / 2; ++y)
+        for (int x = 0; x < w / 2; ++x) {
+            fr->data[1][y * fr->linesize[1] + x] = static_cast<uint8_t>(128 + ((x - i) & 31));
+            fr->data[2][y * fr->linesize[2] + x] = static_cast<uint8_t>(128 - ((y + i) & 31));
+        }
+}
+
+// Manda frame (nullptr drena) e grava os pacotes que saírem.
+bool encode(Encoder& e, AVStream* st, const AVFrame* frame)
+{
+    if (avcodec_send_frame(e.ctx, frame) < 0) return false;
+    for (;;) {
+        int ret = avcodec_receive_packet(e.ctx, e.pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return true;
+        if (ret < 0) return false;
+        av_packet_rescale_ts(e.pkt, e.ctx->time_base, st->time_base);
+        e.pkt->stream_index = st->index;
+        if (av_interleaved_write_frame(e.fmt, e.pkt) < 0) return false;
+    }
+}
+
+} // namespace
+
+bool make_clip(const ClipSpec& spec, const std::string& path)
+{
+    const AVCodec* codec = avcodec_find_encoder_by_name(spec.codec.c_str());
+    if (!codec) return false;
+
+    Encoder e;
+    if (avformat_alloc_output_context2(&e.fmt, nullptr, spec.format.c_str(), path.c_str()) < 0)
+        return false;
+    e.fmt->flags |= AVFMT_FLAG_BITEXACT;
+    AVStream* st = avformat_new_stream(e.fmt, nullptr);
+    e.ctx = avcodec_alloc_context3(codec);
+    if (!st || !e.ctx) return false;
+
+    e.ctx->width        = spec.width;
+    e.ctx->height       = spec.height;
+    e.ctx->pix_fmt      = spec.codec == "mjpeg" ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P;
+    e.ctx->time_base    = AVRational{1, 25};
+    e.ctx->framerate    = AVRational{25, 1};
+    e.ctx->gop_size     = spec.gop;
+    e.ctx->max_b_frames = spec.gop > 2 ? 2 : 0;   // reordenação, como no mundo real
+    if (spec.b_frames >= 0) e.ctx->max_b_frames = spec.b_frames;
+    e.ctx->bit_rate     = static_cast<int64_t>(spec.width) * spec.height * 4;
+    e.ctx->thread_count = 1;
+    e.ctx->flags       |= AV_CODEC_FLAG_BITEXACT;
+    if (e.fmt->oformat->flags & AVFMT_GLOBALHEADER)
+        e.ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary* opts = nullptr;
+    if (spec.codec == "libx264") av_dict_set(&opts, "preset", "veryfast", 0);
+    int ret = avcodec_open2(e.ctx, codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0 || avcodec_parameters_from_context(st->codecpar, e.ctx) < 0)
+        return false;
+    st->time_base = e.ctx->time_base;
+
+    if (avio_open(&e.fmt->pb, path.c_str(), AVIO_FLAG_WRITE) < 0 ||
+        avformat_write_header(e.fmt, nullptr) < 0)
+        return false;
+
+    e.frame = av_frame_alloc();
+    e.pkt = av_packet_alloc();
+    if (!e.frame || !e.pkt) return false;
+    e.frame->format = e.ctx->pix_fmt;
+    e.frame->width  = spec.width;
+    e.frame->height = spec.height;
+    if (av_frame_get_buffer(e.frame, 0) < 0) return false;
+
+    for (int i = 0; i < spec.frames; ++i) {
+        if (av_frame_make_writable(e.frame) < 0) return false;
+        paint(e.frame, i);
+        e.frame->pts = i;
+        if (!encode(e, st, e.frame)) return false;
+    }
+    return encode(e, st, nullptr) && av_write_trailer(e.fmt) >= 0;
+}
+
+std::vector<Clip> make_clips(const std::string& dir)
+{
+    struct Size { int w, h; };
+    const Size sizes[] = {{320, 240}, {1280, 720}};
+    const char* codecs[] = {"libx264", "mpeg4", "mjpeg"};
+    const int frames = 240;
+
+    std::vector<Clip> clips;
+    for (const char* codec : codecs)
+        for (const Size& s : sizes)
+            for (int gop : {12, 120}) {
+                if (std::string(codec) == "mjpeg" && gop != 12) continue;  // só intra
+                ClipSpec spec{codec, s.w, s.h, std::string(codec) == "mjpeg" ? 1 : gop, frames};
+                std::string name = std::string(codec) + '_' + std::to_string(s.w) + 'x' +
+                                   std::to_string(s.h) + "_g" + std::to_string(spec.gop);
+                std::string path = dir + '/' + name + ".mkv";
+                if (make_clip(spec, path)) clips.push_back(Clip{spec, path, name});
+            }
+    return clips;
+}
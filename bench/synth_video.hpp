@@ -0,0 +1,38 @@
+/*
+ *  Clipes sintéticos e determinísticos para os benchmarks.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct ClipSpec {
+    std::string codec;           // nome do encoder (libx264, mpeg4, mjpeg...)
+    int width;
+    int height;
+    int gop;                     // distância entre keyframes
+    int frames;
+    std::string format{"matroska"};  // muxer do libavformat (mp4, mpegts...)
+    int b_frames{-1};            // max_b_frames; -1: 2 se gop > 2
+};
+
+struct Clip {
+    ClipSpec spec;
+    std::string path;
+    std::string name;            // ex.: mpeg4_320x240_g12
+};
+
+// Codifica spec em path no contêiner spec.format. Mesmo conteúdo e mesmos
+// bytes a cada execução: flags bitexact, uma thread, padrão em movimento
+// derivado só do número do frame. false se o encoder não existir neste
+// FFmpeg.
+bool make_clip(const ClipSpec& spec, const std::string& path);
+
+// A matriz padrão (codecs, resoluções e GOPs) em dir; encoders que
+// faltam são pulados.
+std::vector<Clip> make_clips(const std::string& dir);
+
+// Registra os benchmarks de abertura, get_nth_frame/seek_nth_frame e
+// gravação para cada clipe (decode_bench.cpp); dir recebe as saídas.
+void register_decode_benchmarks(const std::vector<Clip>& clips, const std::string& dir);
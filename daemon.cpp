@@ -0,0 +1,167 @@
+/*
+ *  Daemon: pedidos de frame por socket Unix, servidos por um DecoderPool.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void on_signal(int) { stop_requested = 1; }
+
+constexpr std::size_t max_line = 64 * 1024;   // acima disso a conexão cai
+
+struct Client {
+    int fd;
+    std::string in;
+};
+
+bool send_all(int fd, const std::string& s)
+{
+    std::size_t done = 0;
+    while (done < s.size()) {
+        ssize_t w = ::send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+std::string stats_line(const FrameCache* cache)
+{
+    if (!cache) return "err sem cache de frames\n";
+    FrameCacheStats s = cache->stats();
+    return "ok hits=" + std::to_string(s.hits) +
+           " misses=" + std::to_string(s.misses) +
+           " insertions=" + std::to_string(s.insertions) +
+           " evictions=" + std::to_string(s.evictions) +
+           " bytes=" + std::to_string(s.bytes) +
+           " budget=" + std::to_string(cache->budget()) +
+           " entries=" + std::to_string(s.entries) + '\n';
+}
+
+// "video\tframe\tsaída" (ou "stats") -> resposta de uma linha.
+std::string handle(const std::string& line, DecoderPool& pool,
+                   ImageWriter& write, const FrameCache* cache)
+{
+    if (line == "stats") return stats_line(cache);
+
+    std::size_t t1 = line.find('\t');
+    std::size_t t2 = t1 == std::string::npos ? t1 : line.find('\t', t1 + 1);
+    if (t2 == std::string::npos) return "err pedido inválido\n";
+
+    std::string video = line.substr(0, t1);
+    std::string out = line.substr(t2 + 1);
+    std::size_t n;
+    try {
+        n = std::stoul(line.substr(t1 + 1, t2 - t1 - 1));
+    } catch (const std::exception&) {
+        return "err número de frame inválido\n";
+    }
+
+    std::size_t pos = 0;
+    std::shared_ptr<AVFrame> fr = pool.get(video, n, &pos);
+    if (!fr || pos != n) return "err frame não encontrado\n";
+    try {
+        write(fr.get(), out);
+    } catch (const std::runtime_error& e) {
+        return std::string("err ") + e.what() + '\n';
+    }
+    return "ok " + std::to_string(pos) + '\n';
+}
+
+} // namespace
+
+int serve(const std::string& socket_path, DecoderPool& pool,
+          const ScaleSpec& scale, const FrameCache* cache)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof addr.sun_path) {
+        std::cerr << "caminho de socket longo demais\n";
+        return EXIT_FAILURE;
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0) return EXIT_FAILURE;
+    ::unlink(socket_path.c_str());
+    if (::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0 ||
+        ::listen(lfd, 64) < 0) {
+        std::cerr << "não consegui escutar em " << socket_path << '\n';
+        ::close(lfd);
+        return EXIT_FAILURE;
+    }
+
+    // Sem SA_RESTART: o sinal interrompe o poll e o laço termina.
+    struct sigaction sa{};
+    sa.sa_handler = on_signal;
+    ::sigaction(SIGINT, &sa, nullptr);
+    ::sigaction(SIGTERM, &sa, nullptr);
+
+    ImageWriter write(scale);
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    char buf[4096];
+
+    while (!stop_requested) {
+        fds.clear();
+        fds.push_back(pollfd{lfd, POLLIN, 0});
+        for (const Client& c : clients) fds.push_back(pollfd{c.fd, POLLIN, 0});
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (std::size_t i = 1; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+            Client& c = clients[i - 1];
+            ssize_t r = ::recv(c.fd, buf, sizeof buf, 0);
+            bool alive = r > 0 || (r < 0 && errno == EINTR);
+            if (r > 0) c.in.append(buf, static_cast<std::size_t>(r));
+
+            std::size_t nl;
+            while (alive && (nl = c.in.find('\n')) != std::string::npos) {
+                std::string line = c.in.substr(0, nl);
+                c.in.erase(0, nl + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.empty()) continue;
+                alive = send_all(c.fd, handle(line, pool, write, cache));
+            }
+            if (!alive || c.in.size() > max_line) {
+                ::close(c.fd);
+                c.fd = -1;
+            }
+        }
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                     [](const Client& c) { return c.fd < 0; }),
+                      clients.end());
+
+        if (fds[0].revents & POLLIN) {
+            int cfd = ::accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (cfd >= 0) clients.push_back(Client{cfd, std::string()});
+        }
+    }
+
+    for (const Client& c : clients) ::close(c.fd);
+    ::close(lfd);
+    ::unlink(socket_path.c_str());
+    return EXIT_SUCCESS;
+}
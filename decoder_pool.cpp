@@ -0,0 +1,83 @@
+/*
+ *  DecoderPool: VideoFile abertos por caminho, com descarte LRU.
+ */
+
+#include "get_frame.hpp"
+
+#include <sys/stat.h>
+
+VideoFile* DecoderPool::acquire(const std::string& path)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) < 0) return nullptr;
+    const int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                          st.st_mtim.tv_nsec;
+
+    auto it = map_.find(path);
+    if (it != map_.end()) {
+        Entry& e = *it->second;
+        if (e.dev == static_cast<uint64_t>(st.st_dev) &&
+            e.ino == static_cast<uint64_t>(st.st_ino) &&
+            e.size == static_cast<uint64_t>(st.st_size) && e.mtime == mtime) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return e.video.get();
+        }
+        lru_.erase(it->second);       // mudou no disco: reabre
+        map_.erase(it);
+    }
+
+    Entry e{path, static_cast<uint64_t>(st.st_dev),
+            static_cast<uint64_t>(st.st_ino), static_cast<uint64_t>(st.st_size),
+            mtime, std::make_unique<FrameIndex>(), nullptr};
+    e.index->load(index_path(path), path);
+    e.video = std::make_unique<VideoFile>(path);
+    e.video->use_index(e.index.get());
+    e.video->fast_forward(cfg_.fast);
+    e.video->input(cfg_.input);
+    e.video->threads(cfg_.threads, cfg_.thread_type);
+    e.video->use_stats(cfg_.stats);
+    if (!e.video->open()) return nullptr;
+    // Sem sidecar, o índice do contêiner, se exato: o daemon busca entre
+    // pedidos, e o demuxer já o leu no cabeçalho.
+    if (!e.index->loaded()) e.video->index_container(*e.index, false);
+
+    lru_.push_front(std::move(e));
+    map_[path] = lru_.begin();
+    while (lru_.size() > capacity_) {
+        map_.erase(lru_.back().path);
+        lru_.pop_back();
+    }
+    return lru_.front().video.get();
+}
+
+// Caminho e versão do arquivo: um vídeo reescrito não reaproveita frames.
+std::string DecoderPool::cache_key(const Entry& e)
+{
+    return e.path + '\n' + std::to_string(e.dev) + ':' + std::to_string(e.ino) +
+           ':' + std::to_string(e.size) + ':' + std::to_string(e.mtime);
+}
+
+std::shared_ptr<AVFrame> DecoderPool::get(const std::string& path, std::size_t n,
+                                          std::size_t* position)
+{
+    VideoFile* vf = acquire(path);
+    if (!vf) return nullptr;
+    const Entry& e = lru_.front();
+
+    std::string key;
+    if (cache_) {
+        key = cache_key(e);
+        if (std::shared_ptr<AVFrame> hit = cache_->find(key, n)) {
+            if (position) *position = n;
+            return hit;
+        }
+    }
+
+    // Com índice o próprio VideoFile sabe quando o seek compensa.
+    std::size_t gap = e.index->loaded() ? 0 : cfg_.seek_gap;
+    AVFrame* fr = get_nth_frame_near(*vf, n, gap);
+    if (!fr) return nullptr;
+    if (position) *position = vf->position();
+    if (cache_) return cache_->insert(key, vf->position(), fr);
+    return std::shared_ptr<AVFrame>(fr, [](AVFrame*) {});   // do decodificador
+}
@@ -0,0 +1,196 @@
+/*
+ *  Extração de todos os frames em paralelo, GOP a GOP, com roubo de
+ *  trabalho entre os workers.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Frames [first, last) de um GOP com pelo menos um frame a gravar.
+struct Gop {
+    std::size_t first;
+    std::size_t last;
+};
+
+// Uma deque por worker: o dono consome pela frente (segue adiante no
+// arquivo), os ladrões levam do fim (o trecho mais longe do dono).
+class GopQueues {
+public:
+    GopQueues(const std::vector<Gop>& gops, std::size_t workers)
+        : q_(workers)
+    {
+        for (std::size_t w = 0, i = 0; w < workers; ++w) {
+            std::size_t end = gops.size() * (w + 1) / workers;
+            for (; i < end; ++i) q_[w].gops.push_back(gops[i]);
+        }
+    }
+
+    bool take(std::size_t self, Gop& g)
+    {
+        {
+            Queue& own = q_[self];
+            std::lock_guard<std::mutex> lock(own.mu);
+            if (!own.gops.empty()) {
+                g = own.gops.front();
+                own.gops.pop_front();
+                return true;
+            }
+        }
+        for (std::size_t k = 1; k < q_.size(); ++k) {
+            Queue& victim = q_[(self + k) % q_.size()];
+            std::lock_guard<std::mutex> lock(victim.mu);
+            if (!victim.gops.empty()) {
+                g = victim.gops.back();
+                victim.gops.pop_back();
+                return true;
+            }
+        }
+        return false;             // ninguém cria trabalho novo: acabou
+    }
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<Gop> gops;
+    };
+    std::vector<Queue> q_;
+};
+
+// GOPs do índice que contêm algum múltiplo de every.
+std::vector<Gop> split_gops(const FrameIndex& index, std::size_t every)
+{
+    std::vector<Gop> gops;
+    const std::size_t count = index.size();
+    for (std::size_t k = 0; k < count;) {
+        std::size_t end = k + 1;
+        while (end < count && index[end].key != end) ++end;
+        std::size_t n = (k + every - 1) / every * every;   // primeiro alvo
+        if (n < end) gops.push_back(Gop{k, end});
+        k = end;
+    }
+    return gops;
+}
+
+void run_worker(const std::string& video, const FrameIndex& index,
+                const DumpConfig& cfg, GopQueues& queues, std::size_t self,
+                std::atomic<std::size_t>& written, std::atomic<std::size_t>& failed)
+{
+    VideoFile vf(video);
+    vf.use_index(&index);
+    vf.fast_forward(cfg.decoder.fast);
+    vf.input(cfg.decoder.input);
+    vf.threads(cfg.decoder.threads, cfg.decoder.thread_type);
+    vf.use_stats(cfg.decoder.stats);
+    ImageWriter write(cfg.scale);
+    write.use_stats(cfg.decoder.stats);
+    const bool ok = vf.open();
+
+    Gop g;
+    while (queues.take(self, g)) {
+        std::size_t n = (g.first + cfg.every - 1) / cfg.every * cfg.every;
+        if (!ok) {
+            failed += (g.last - n + cfg.every - 1) / cfg.every;
+            continue;
+        }
+        // O seek é nulo dentro do GOP e entre GOPs seguidos.
+        for (; n < g.last; n += cfg.every) {
+            AVFrame* fr = seek_nth_frame(vf, n);
+            if (!fr || vf.position() != n) {
+                ++failed;
+                continue;
+            }
+            try {
+                write(fr, frame_name(cfg.pattern, n));
+                ++written;
+            } catch (const std::exception&) {
+                ++failed;
+            }
+        }
+    }
+}
+
+} // namespace
+
+void share_cpus(unsigned& jobs, int& threads, std::size_t work)
+{
+    const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned cap = static_cast<unsigned>(
+        std::max<std::size_t>(1, std::min<std::size_t>(work, cpus)));
+    if (threads < 0) threads = 0;
+    if (jobs > cap) jobs = cap;
+    if (jobs == 0 && threads == 0) {
+        jobs = cap;
+        threads = static_cast<int>(std::max(1u, cpus / jobs));
+    } else if (jobs == 0) {
+        jobs = std::min(cap, std::max(1u, cpus / static_cast<unsigned>(threads)));
+    } else if (threads == 0) {
+        threads = static_cast<int>(std::max(1u, cpus / jobs));
+    }
+    // Os dois fixados e acima do orçamento: corta threads, depois workers.
+    while (jobs * static_cast<unsigned>(threads) > cpus && threads > 1) --threads;
+    jobs = std::min(jobs, cpus);
+}
+
+std::string frame_name(const std::string& pattern, std::size_t n)
+{
+    std::string out;
+    bool done = false;
+    for (std::size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%' || i + 1 == pattern.size()) {
+            out += pattern[i];
+            continue;
+        }
+        if (pattern[i + 1] == '%') {
+            out += '%';
+            ++i;
+            continue;
+        }
+        std::size_t j = i + 1;
+        bool zero = j < pattern.size() && pattern[j] == '0';
+        if (zero) ++j;
+        std::size_t width = 0;
+        for (; j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9'; ++j)
+            width = width * 10 + (pattern[j] - '0');
+        if (done || j == pattern.size() || pattern[j] != 'd') {
+            out += pattern[i];    // não é conversão: copia literal
+            continue;
+        }
+        std::string num = std::to_string(n);
+        if (num.size() < width) out.append(width - num.size(), zero ? '0' : ' ');
+        out += num;
+        done = true;
+        i = j;
+    }
+    return out;
+}
+
+ExtractResult dump_frames(const std::string& video, const FrameIndex& index,
+                          const DumpConfig& cfg)
+{
+    if (!index.loaded()) throw std::runtime_error("dump needs a frame index");
+    if (!has_frame_number(cfg.pattern))
+        throw std::runtime_error("dump pattern has no %d conversion");
+    DumpConfig c = cfg;
+    if (c.every == 0) c.every = 1;
+    std::vector<Gop> gops = split_gops(index, c.every);
+    share_cpus(c.jobs, c.decoder.threads, gops.size());
+    const std::size_t workers = c.jobs;
+
+    GopQueues queues(gops, workers);
+    std::atomic<std::size_t> written{0}, failed{0};
+    std::vector<std::thread> pool;
+    for (std::size_t w = 1; w < workers; ++w)
+        pool.emplace_back(run_worker, std::cref(video), std::cref(index),
+                          std::cref(c), std::ref(queues), w,
+                          std::ref(written), std::ref(failed));
+    run_worker(video, index, c, queues, 0, written, failed);
+    for (std::thread& t : pool) t.join();
+    return ExtractResult{written.load(), failed.load()};
+}
@@ -0,0 +1,81 @@
+/*
+ *  FrameCache: frames decodificados com orçamento em bytes e LRU.
+ */
+
+#include "get_frame.hpp"
+
+namespace {
+
+std::size_t frame_bytes(const AVFrame* fr)
+{
+    std::size_t n = 0;
+    for (const AVBufferRef* b : fr->buf)
+        if (b) n += b->size;
+    return n;
+}
+
+} // namespace
+
+std::shared_ptr<AVFrame> FrameCache::find(const std::string& file, std::size_t n)
+{
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = map_.find(Key{file, n});
+    if (it == map_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->frame;
+}
+
+std::shared_ptr<AVFrame> FrameCache::insert(const std::string& file,
+                                            std::size_t n, const AVFrame* fr)
+{
+    AVFrame* ref = av_frame_alloc();
+    if (!ref || av_frame_ref(ref, fr) < 0) {
+        av_frame_free(&ref);
+        return nullptr;
+    }
+    std::shared_ptr<AVFrame> shared(ref, [](AVFrame* f) { av_frame_free(&f); });
+    std::size_t bytes = frame_bytes(ref);
+
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = map_.find(Key{file, n});
+    if (it != map_.end()) {                   // substitui a versão antiga
+        stats_.bytes -= it->second->bytes;
+        lru_.erase(it->second);
+        map_.erase(it);
+    }
+    if (bytes > budget_) return shared;
+    evict_to(budget_ - bytes);
+    lru_.push_front(Entry{Key{file, n}, shared, bytes});
+    map_[lru_.front().key] = lru_.begin();
+    stats_.bytes += bytes;
+    ++stats_.insertions;
+    return shared;
+}
+
+void FrameCache::evict_to(std::size_t budget)
+{
+    while (!lru_.empty() && stats_.bytes > budget) {
+        stats_.bytes -= lru_.back().bytes;
+        map_.erase(lru_.back().key);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+FrameCacheStats FrameCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mu_);
+    FrameCacheStats s = stats_;
+    s.entries = lru_.size();
+    return s;
+}
+
+void FrameCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mu_);
+    evict_to(0);
+}
@@ -0,0 +1,307 @@
+/*
+ *  Índice de frames em sidecar: construção (só demux) e leitura via mmap;
+ *  ou montado em memória do índice que o demuxer aberto já tem.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char     index_magic[8] = {'G', 'F', 'I', 'D', 'X', '0', '1', '\n'};
+constexpr uint32_t index_version  = 1;
+
+int64_t mtime_ns(const struct stat& st)
+{
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+           st.st_mtim.tv_nsec;
+}
+
+int first_video_stream(const AVFormatContext* fmt)
+{
+    for (unsigned i = 0; i < fmt->nb_streams; ++i)
+        if (fmt->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+            return static_cast<int>(i);
+    return -1;
+}
+
+// Em ordem de apresentação, o GOP de um frame começa no último keyframe
+// que não o sucede (vale também para GOP aberto).
+void assign_keys(std::vector<IndexEntry>& entries)
+{
+    uint32_t key = 0;
+    for (std::size_t n = 0; n < entries.size(); ++n) {
+        if (entries[n].flags & index_keyframe) key = static_cast<uint32_t>(n);
+        entries[n].key = key;
+    }
+}
+
+// Tabela de amostras completa (MP4/MOV): uma entrada por amostra, em ordem
+// de decodificação e com o dts. O pts de cada frame é reconstruído como
+// dts + atraso de reordenação (pts inicial - dts da primeira amostra). Sem
+// reordenação (pts == dts) é exato; com frames B só os instantes batem,
+// e só em CFR: offset e keyframe de cada entrada podem ser de outro frame.
+void sample_table(const std::vector<AVIndexEntry>& samples, int64_t shift,
+                  std::vector<IndexEntry>& out)
+{
+    out.reserve(samples.size());
+    for (const AVIndexEntry& e : samples)
+        out.push_back(IndexEntry{
+            e.timestamp + shift, e.pos, 0,
+            (e.flags & AVINDEX_KEYFRAME) ? index_keyframe : 0});
+}
+
+// Só keyframes (cues do Matroska): um frame por período da taxa média,
+// com os pts que ela dá; cada cue marca o frame mais próximo do seu pts
+// como keyframe, com o pts e o offset exatos.
+bool cue_table(const AVFormatContext* fmt, const AVStream* st,
+               const std::vector<AVIndexEntry>& cues, int64_t start,
+               std::vector<IndexEntry>& out)
+{
+    AVRational rate = st->avg_frame_rate;
+    if (rate.num <= 0 || rate.den <= 0) rate = st->r_frame_rate;
+    if (rate.num <= 0 || rate.den <= 0) return false;
+    const AVRational period = av_inv_q(rate);
+
+    int64_t frames = st->nb_frames;
+    if (frames <= 0 && st->duration > 0)
+        frames = av_rescale_q_rnd(st->duration, st->time_base, period,
+                                  AV_ROUND_NEAR_INF);
+    if (frames <= 0 && fmt->duration > 0)
+        frames = av_rescale_q_rnd(fmt->duration, AVRational{1, AV_TIME_BASE},
+                                  period, AV_ROUND_NEAR_INF);
+    if (frames <= 0) return false;
+
+    out.resize(static_cast<std::size_t>(frames));
+    for (std::size_t n = 0; n < out.size(); ++n)
+        out[n] = IndexEntry{
+            start + av_rescale_q(static_cast<int64_t>(n), period, st->time_base),
+            -1, 0, 0};
+    out[0].flags = index_keyframe;    // o stream sempre abre num keyframe
+    for (const AVIndexEntry& e : cues) {
+        int64_t n = av_rescale_q_rnd(e.timestamp - start, st->time_base, period,
+                                     AV_ROUND_NEAR_INF);
+        if (n < 0 || n >= frames) continue;
+        IndexEntry& f = out[static_cast<std::size_t>(n)];
+        f.pts = e.timestamp;
+        f.pos = e.pos;
+        f.flags = index_keyframe;
+    }
+    return true;
+}
+
+// Entradas do índice do demuxer ordenadas pelo timestamp, sem as
+// descartadas; dense se for tabela de amostras (algum não keyframe).
+std::vector<AVIndexEntry> index_entries(AVStream* st, bool& dense)
+{
+    std::vector<AVIndexEntry> samples;
+    dense = false;
+    const int count = avformat_index_get_entries_count(st);
+    for (int i = 0; i < count; ++i) {
+        const AVIndexEntry* e = avformat_index_get_entry(st, i);
+        if (!e || (e->flags & AVINDEX_DISCARD_FRAME)) continue;
+        if (!(e->flags & AVINDEX_KEYFRAME)) dense = true;
+        samples.push_back(*e);
+    }
+    std::stable_sort(samples.begin(), samples.end(),
+        [](const AVIndexEntry& a, const AVIndexEntry& b) {
+            return a.timestamp < b.timestamp;
+        });
+    // Só intra também é tabela completa, se cobre todos os frames.
+    if (st->nb_frames > 0 && samples.size() >= static_cast<uint64_t>(st->nb_frames))
+        dense = true;
+    return samples;
+}
+
+} // namespace
+
+bool FrameIndex::load(const std::string& sidecar, const std::string& video)
+{
+    unload();
+    struct stat vs, is;
+    if (::stat(video.c_str(), &vs) < 0) return false;
+    int fd = ::open(sidecar.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    if (::fstat(fd, &is) < 0 ||
+        static_cast<std::size_t>(is.st_size) < sizeof(IndexHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* p = ::mmap(nullptr, is.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    map_ = p;
+    map_size_ = is.st_size;
+
+    const IndexHeader* h = static_cast<const IndexHeader*>(p);
+    if (std::memcmp(h->magic, index_magic, sizeof index_magic) != 0 ||
+        h->version != index_version ||
+        map_size_ != sizeof(IndexHeader) + h->count * sizeof(IndexEntry) ||
+        h->file_size != static_cast<uint64_t>(vs.st_size) ||
+        h->file_mtime != mtime_ns(vs)) {
+        unload();
+        return false;
+    }
+    entries_ = reinterpret_cast<const IndexEntry*>(h + 1);
+    count_ = h->count;
+    stream_ = h->stream_index;
+    tb_ = AVRational{h->tb_num, h->tb_den};
+    exact_ = true;
+    return true;
+}
+
+void FrameIndex::unload()
+{
+    if (map_) ::munmap(map_, map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+    owned_.clear();
+    owned_.shrink_to_fit();
+    entries_ = nullptr;
+    count_ = 0;
+    stream_ = -1;
+    tb_ = AVRational{0, 1};
+    exact_ = false;
+}
+
+std::size_t FrameIndex::find(int64_t pts) const
+{
+    const IndexEntry* last = entries_ + size();
+    const IndexEntry* it = std::lower_bound(entries_, last, pts,
+        [](const IndexEntry& e, int64_t t) { return e.pts < t; });
+    // pts do índice do contêiner podem vir da taxa média: o mais próximo
+    if (it != entries_ && (it == last || pts - (it - 1)->pts < it->pts - pts))
+        --it;
+    return static_cast<std::size_t>(it - entries_);
+}
+
+std::size_t FrameIndex::nearest_key(std::size_t n) const
+{
+    if (size() == 0) return n;
+    n = std::min(n, size() - 1);
+    const std::size_t before = entries_[n].key;
+    // key cresce com o frame: o primeiro com key > n abre o GOP seguinte
+    const IndexEntry* last = entries_ + size();
+    const IndexEntry* it = std::partition_point(entries_ + n, last,
+        [n](const IndexEntry& e) { return e.key <= n; });
+    if (it == last) return before;
+    const std::size_t after = static_cast<std::size_t>(it - entries_);
+    return after - n < n - before ? after : before;
+}
+
+bool FrameIndex::from_container(AVFormatContext* fmt, int stream, bool estimated)
+{
+    unload();
+    if (stream < 0 || static_cast<unsigned>(stream) >= fmt->nb_streams) return false;
+    AVStream* st = fmt->streams[stream];
+
+    bool dense;
+    std::vector<AVIndexEntry> samples = index_entries(st, dense);
+    // Sem tabela de amostras o índice só pode ser estimado; o matroska só
+    // lê os cues no primeiro seek, que aqui vai ao começo.
+    if (!dense) {
+        if (!estimated) return false;
+        av_seek_frame(fmt, stream, st->start_time != AV_NOPTS_VALUE ? st->start_time : 0,
+                      AVSEEK_FLAG_BACKWARD);
+        samples = index_entries(st, dense);
+    }
+    if (samples.empty()) return false;
+
+    // O pts inicial vem do probe; a tabela de amostras traz dts, e a
+    // diferença no primeiro frame é o atraso de reordenação.
+    const int64_t start = st->start_time != AV_NOPTS_VALUE ? st->start_time
+                                                            : samples.front().timestamp;
+    bool ok = true;
+    if (dense)
+        sample_table(samples, start - samples.front().timestamp, owned_);
+    else
+        ok = cue_table(fmt, st, samples, start, owned_);
+    if (!ok || owned_.empty()) {
+        owned_.clear();
+        return false;
+    }
+
+    assign_keys(owned_);
+    entries_ = owned_.data();
+    count_ = owned_.size();
+    stream_ = stream;
+    tb_ = st->time_base;
+    // Sem frames B (atraso de decodificação zero) o dts é o pts, e a
+    // tabela numera como a contagem se começa no primeiro frame.
+    exact_ = dense && st->codecpar->video_delay == 0 &&
+             samples.front().timestamp == start;
+    return true;
+}
+
+bool FrameIndex::build(const std::string& video, const std::string& sidecar)
+{
+    struct stat vs;
+    if (::stat(video.c_str(), &vs) < 0) return false;
+
+    AVFormatContext* fmt = nullptr;
+    if (avformat_open_input(&fmt, video.c_str(), nullptr, nullptr) < 0)
+        return false;
+    if (avformat_find_stream_info(fmt, nullptr) < 0) {
+        avformat_close_input(&fmt);
+        return false;
+    }
+    int stream = first_video_stream(fmt);
+    if (stream == -1) {
+        avformat_close_input(&fmt);
+        return false;
+    }
+    for (unsigned i = 0; i < fmt->nb_streams; ++i)
+        if (static_cast<int>(i) != stream)
+            fmt->streams[i]->discard = AVDISCARD_ALL;
+
+    std::vector<IndexEntry> entries;
+    AVPacket* pkt = av_packet_alloc();
+    while (av_read_frame(fmt, pkt) >= 0) {
+        if (pkt->stream_index == stream && !(pkt->flags & AV_PKT_FLAG_DISCARD)) {
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (ts != AV_NOPTS_VALUE)
+                entries.push_back(IndexEntry{
+                    ts, pkt->pos, 0,
+                    (pkt->flags & AV_PKT_FLAG_KEY) ? index_keyframe : 0});
+        }
+        av_packet_unref(pkt);
+    }
+    av_packet_free(&pkt);
+    AVRational tb = fmt->streams[stream]->time_base;
+    avformat_close_input(&fmt);
+
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const IndexEntry& a, const IndexEntry& b) { return a.pts < b.pts; });
+    assign_keys(entries);
+
+    IndexHeader h{};
+    std::memcpy(h.magic, index_magic, sizeof index_magic);
+    h.version      = index_version;
+    h.stream_index = stream;
+    h.tb_num       = tb.num;
+    h.tb_den       = tb.den;
+    h.file_size    = static_cast<uint64_t>(vs.st_size);
+    h.file_mtime   = mtime_ns(vs);
+    h.count        = entries.size();
+
+    std::string tmp = sidecar + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&h, sizeof h, 1, f) == 1 &&
+              std::fwrite(entries.data(), sizeof(IndexEntry),
+                          entries.size(), f) == entries.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), sidecar.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
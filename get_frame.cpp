@@ -1,170 +1,452 @@
 /*
  *  EOP-style single-frame extractor
  *  g++ (ou cmake) + FFmpeg
- *  Uso: ./get_frame video.mp4 150 out.ppm
+ *  Uso: ./get_frame [--seek] [--fast] [--bisect] [--threads n|auto] [--thread-type t]
+ *                   [--approx] [--deadline-ms ms] [--mmap|--prefetch] [--stats]
+ *                   [--width w] [--height h] [--fit] [--scaler s]
+ *                   [--index arq] [--cache-dir dir] video.mp4 150 out.ppm|out.pgm
+ *       ./get_frame --build-index [--index arq] video.mp4
+ *       ./get_frame --batch lista.txt [--seek-gap n] [--pipeline] [--cache-dir dir] video.mp4
+ *       ./get_frame --dump out/f%06d.ppm [--every k] [--jobs n] video.mp4
+ *       ./get_frame --manifest lista.tsv [--jobs n] [--threads n|auto]
+ *       ./get_frame --daemon sock [--pool n] [--frame-cache mb]
  */
 
 #include <cstdlib>
 #include <iostream>
 #include <string>
-#include <stdexcept>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <memory>
+#include <stdexcept>
 
-extern "C" {
-#include <libavformat/avformat.h>
-#include <libavcodec/avcodec.h>
-#include <libswscale/swscale.h>
-#include <libavutil/imgutils.h>
-}
-
-/* ---------- Conceitos (EOP) ---------- */
+#include "get_frame.hpp"
 
-// T satisfaz FrameSource se possuir:
-//   - open()  -> bool
-//   - read()  -> AVFrame*
-//   - close() -> void
-// (definido informalmente aqui)
+/* ---------- main ---------- */
 
-/* ---------- Abstração genérica ---------- */
+struct Options {
+    bool seek{false};
+    bool fast{false};
+    bool approx{false};              // keyframe mais próximo, um só frame
+    unsigned deadline_ms{0};         // 0 = sem prazo
+    bool build_index{false};
+    int threads{-1};                 // 0 = automático; -1 = não dado
+    int thread_type{FF_THREAD_FRAME | FF_THREAD_SLICE};
+    ScaleSpec scale;
+    std::string index;               // vazio: video + ".gfidx"
+    std::string batch;               // lista "frame saída" por linha; "-" = stdin
+    bool pipeline{false};            // batch com uma thread por estágio
+    std::size_t seek_gap{250};       // sem índice: distância que justifica seek
+    std::string daemon;              // socket Unix do modo daemon
+    std::size_t pool{16};            // decodificadores abertos no daemon
+    std::size_t frame_cache{0};      // MiB de frames decodificados; 0 = sem cache
+    std::string cache_dir;           // cache de resultados em disco; vazio = sem
+    std::string dump;                // padrão de saída da extração completa
+    std::size_t every{1};            // no dump: só os múltiplos de every
+    unsigned jobs{0};                // workers do dump/manifesto; 0 = automático
+    bool stats{false};               // --stats: relatório JSON em stderr
+    InputMode input{InputMode::file}; // --mmap / --prefetch
+    Stats* sink{nullptr};            // onde as medições caem, se stats
+    std::string manifest;            // "video\tframe\tsaída" por linha; "-" = stdin
+    std::string video;
+    std::size_t frame{0};
+    std::string out;
+};
 
-template <typename Src>
-AVFrame* get_nth_frame(Src& src, std::size_t n)
+bool parse_args(int argc, char* argv[], Options& opt)
 {
-    if (!src.open()) throw std::runtime_error("cannot open source");
-
-    AVFrame* fr = nullptr;
-    for (std::size_t i = 0; i <= n; ++i) {
-        fr = src.read();          // pode retornar nullptr (EOF)
-        if (!fr) break;
+    int pos = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (std::strcmp(a, "--seek") == 0) {
+            opt.seek = true;
+        } else if (std::strcmp(a, "--fast") == 0) {
+            opt.fast = opt.seek = true;   // o alvo chega ao decoder pelo seek
+        } else if (std::strcmp(a, "--bisect") == 0) {
+            opt.seek = true;              // a bissecção já é automática em TS/PS
+        } else if (std::strcmp(a, "--approx") == 0) {
+            opt.approx = opt.seek = true;
+        } else if (std::strcmp(a, "--deadline-ms") == 0 && i + 1 < argc) {
+            opt.deadline_ms = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (std::strcmp(a, "--threads") == 0 && i + 1 < argc) {
+            ++i;
+            opt.threads = std::strcmp(argv[i], "auto") == 0 ? 0 : std::stoi(argv[i]);
+            if (opt.threads < 0) return false;
+        } else if (std::strcmp(a, "--thread-type") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "frame") == 0)      opt.thread_type = FF_THREAD_FRAME;
+            else if (std::strcmp(argv[i], "slice") == 0) opt.thread_type = FF_THREAD_SLICE;
+            else if (std::strcmp(argv[i], "both") == 0)
+                opt.thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            else return false;
+        } else if (std::strcmp(a, "--width") == 0 && i + 1 < argc) {
+            opt.scale.width = std::stoi(argv[++i]);
+        } else if (std::strcmp(a, "--height") == 0 && i + 1 < argc) {
+            opt.scale.height = std::stoi(argv[++i]);
+        } else if (std::strcmp(a, "--fit") == 0) {
+            opt.scale.fit = true;
+        } else if (std::strcmp(a, "--scaler") == 0 && i + 1 < argc) {
+            opt.scale.flags = scaler_flags(argv[++i]);
+            if (opt.scale.flags < 0) return false;
+        } else if (std::strcmp(a, "--build-index") == 0) {
+            opt.build_index = true;
+        } else if (std::strcmp(a, "--index") == 0 && i + 1 < argc) {
+            opt.index = argv[++i];
+        } else if (std::strcmp(a, "--batch") == 0 && i + 1 < argc) {
+            opt.batch = argv[++i];
+        } else if (std::strcmp(a, "--mmap") == 0) {
+            opt.input = InputMode::mmap;
+        } else if (std::strcmp(a, "--prefetch") == 0) {
+            opt.input = InputMode::prefetch;
+        } else if (std::strcmp(a, "--stats") == 0) {
+            opt.stats = true;
+        } else if (std::strcmp(a, "--pipeline") == 0) {
+            opt.pipeline = true;
+        } else if (std::strcmp(a, "--seek-gap") == 0 && i + 1 < argc) {
+            opt.seek_gap = std::stoul(argv[++i]);
+        } else if (std::strcmp(a, "--daemon") == 0 && i + 1 < argc) {
+            opt.daemon = argv[++i];
+        } else if (std::strcmp(a, "--pool") == 0 && i + 1 < argc) {
+            opt.pool = std::stoul(argv[++i]);
+        } else if (std::strcmp(a, "--frame-cache") == 0 && i + 1 < argc) {
+            opt.frame_cache = std::stoul(argv[++i]);
+        } else if (std::strcmp(a, "--cache-dir") == 0 && i + 1 < argc) {
+            opt.cache_dir = argv[++i];
+        } else if (std::strcmp(a, "--dump") == 0 && i + 1 < argc) {
+            opt.dump = argv[++i];
+        } else if (std::strcmp(a, "--every") == 0 && i + 1 < argc) {
+            opt.every = std::stoul(argv[++i]);
+            if (opt.every == 0) return false;
+        } else if (std::strcmp(a, "--manifest") == 0 && i + 1 < argc) {
+            opt.manifest = argv[++i];
+        } else if (std::strcmp(a, "--jobs") == 0 && i + 1 < argc) {
+            opt.jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (a[0] == '-' && a[1] == '-') {
+            return false;
+        } else {
+            switch (pos++) {
+            case 0: opt.video = a; break;
+            case 1: opt.frame = std::stoul(a); break;
+            case 2: opt.out = a; break;
+            default: return false;
+            }
+        }
     }
-    src.close();
-    return fr;
+    if (opt.index.empty() && pos > 0) opt.index = index_path(opt.video);
+    // Sem --threads: uma num frame só; no --dump e no manifesto share_cpus
+    // divide os núcleos entre workers e threads.
+    if (opt.threads < 0) opt.threads = opt.dump.empty() && opt.manifest.empty() ? 1 : 0;
+    // --approx e --deadline-ms só valem para um frame único
+    const bool single = !opt.build_index && opt.batch.empty() && opt.dump.empty() &&
+                        opt.manifest.empty() && opt.daemon.empty();
+    if ((opt.approx || opt.deadline_ms) && !single) return false;
+    if (!opt.daemon.empty() || !opt.manifest.empty()) return pos == 0;
+    return pos == (opt.build_index || !opt.batch.empty() || !opt.dump.empty() ? 1 : 3);
 }
 
-/* ---------- Modelo concreto que satisfaz FrameSource ---------- */
-
-class VideoFile {
-public:
-    explicit VideoFile(const std::string& path) : path_(path) {}
+// Como os modos com vários VideoFile abrem cada um.
+DecoderConfig decoder_config(const Options& opt)
+{
+    return DecoderConfig{opt.fast, opt.threads, opt.thread_type, opt.seek_gap,
+                         opt.sink, opt.input};
+}
 
-    bool open()
-    {
-        if (avformat_open_input(&fmt_, path_.c_str(), nullptr, nullptr) < 0)
-            return false;
-        if (avformat_find_stream_info(fmt_, nullptr) < 0)
+// Lê pedidos "numero_frame saída", um por linha; linhas vazias e
+// começadas por '#' são ignoradas.
+bool read_requests(std::istream& in, std::vector<FrameRequest>& reqs)
+{
+    std::string line;
+    while (std::getline(in, line)) {
+        std::size_t b = line.find_first_not_of(" \t");
+        if (b == std::string::npos || line[b] == '#') continue;
+        std::size_t e = line.find_first_of(" \t", b);
+        std::size_t o = line.find_first_not_of(" \t", e);
+        if (e == std::string::npos || o == std::string::npos) return false;
+        // Só dígitos: stoul aceitaria "12abc" e "-1", e lança no resto.
+        const std::string frame = line.substr(b, e - b);
+        if (frame.find_first_not_of("0123456789") != std::string::npos) return false;
+        std::size_t n;
+        try {
+            n = std::stoul(frame);
+        } catch (const std::out_of_range&) {
             return false;
+        }
+        std::size_t oe = line.find_last_not_of(" \t\r");
+        reqs.push_back(FrameRequest{n, line.substr(o, oe - o + 1)});
+    }
+    return true;
+}
 
-        for (unsigned i = 0; i < fmt_->nb_streams; ++i)
-            if (fmt_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-                stream_index_ = static_cast<int>(i);
-                break;
-            }
-        if (stream_index_ == -1) return false;
-
-        const AVCodec* codec = avcodec_find_decoder(
-            fmt_->streams[stream_index_]->codecpar->codec_id);
-        if (!codec) return false;
+bool load_requests(const Options& opt, std::vector<FrameRequest>& reqs)
+{
+    if (opt.batch == "-") return read_requests(std::cin, reqs);
+    std::ifstream in(opt.batch);
+    return in && read_requests(in, reqs);
+}
 
-        codec_ctx_ = avcodec_alloc_context3(codec);
-        if (!codec_ctx_) return false;
-        avcodec_parameters_to_context(
-            codec_ctx_, fmt_->streams[stream_index_]->codecpar);
-        if (avcodec_open2(codec_ctx_, codec, nullptr) < 0) return false;
+// reqs em ordem de frame.
+int run_batch(const Options& opt, std::vector<FrameRequest>& reqs,
+              std::size_t cached, VideoFile& vf, const FrameIndex& idx,
+              const ResultCache* cache, const std::string& mode)
+{
+    auto store = [&](const FrameRequest& r) {
+        if (cache)
+            cache->store(cache->key(opt.video, r.frame, opt.scale, r.out, mode), r.out);
+    };
 
-        frame_ = av_frame_alloc();
-        pkt_   = av_packet_alloc();
-        return true;
+    if (opt.pipeline) {
+        ExtractResult r = pipeline_frames(vf, idx, reqs, opt.scale, 16, store, opt.sink);
+        std::cout << (cached + r.written) << " frames salvos";
+        if (cached) std::cout << " (" << cached << " do cache)";
+        std::cout << '\n';
+        if (r.failed) std::cerr << r.failed << " frames falharam\n";
+        return r.failed ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 
-    AVFrame* read()   // retorna nullptr em EOF ou erro
-    {
-        while (av_read_frame(fmt_, pkt_) >= 0) {
-            if (pkt_->stream_index != stream_index_) {
-                av_packet_unref(pkt_);
-                continue;
-            }
-            int ret = avcodec_send_packet(codec_ctx_, pkt_);
-            av_packet_unref(pkt_);
-            if (ret < 0) continue;
-
-            ret = avcodec_receive_frame(codec_ctx_, frame_);
-            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-                continue;
-            if (ret < 0) return nullptr;
-            return frame_;   // devolve ponteiro "vivo" (não copia)
+    // Com índice o próprio VideoFile sabe quando o seek compensa.
+    ImageWriter write(opt.scale);
+    write.use_stats(opt.sink);
+    std::size_t saved = get_frames(vf, reqs.begin(), reqs.end(),
+                                   idx.loaded() ? 0 : opt.seek_gap,
+                                   [&](const AVFrame* fr, const FrameRequest& r) {
+                                       if (!fr) {
+                                           std::cerr << "frame não encontrado: "
+                                                     << r.frame << '\n';
+                                           return;
+                                       }
+                                       write(fr, r.out);
+                                       store(r);
+                                   });
+    std::cout << (cached + saved) << " frames salvos";
+    if (cached) std::cout << " (" << cached << " do cache)";
+    std::cout << '\n';
+    return saved == reqs.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Sem índice exato (sidecar ou do contêiner) não há GOPs para dividir:
+// constrói o sidecar antes.
+int run_dump(const Options& opt)
+{
+    if (!has_frame_number(opt.dump)) {
+        std::cerr << "o padrão do --dump precisa de %d (ex.: out/f%06d.ppm): "
+                  << opt.dump << '\n';
+        return EXIT_FAILURE;
+    }
+    FrameIndex idx;
+    if (!idx.load(opt.index, opt.video)) {
+        VideoFile vf(opt.video);     // só o demuxer: o índice do contêiner
+        vf.input(opt.input);
+        if (!(vf.open() && vf.index_container(idx, false)) &&
+            !(FrameIndex::build(opt.video, opt.index) && idx.load(opt.index, opt.video))) {
+            std::cerr << "não consegui indexar o vídeo\n";
+            return EXIT_FAILURE;
         }
-        return nullptr;
     }
+    DumpConfig cfg;
+    cfg.pattern = opt.dump;
+    cfg.every = opt.every;
+    cfg.jobs = opt.jobs;
+    cfg.decoder = decoder_config(opt);
+    cfg.scale = opt.scale;
+    ExtractResult r = dump_frames(opt.video, idx, cfg);
+    std::cout << r.written << " frames salvos\n";
+    if (r.failed) std::cerr << r.failed << " frames falharam\n";
+    return r.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-    void close()
-    {
-        if (pkt_)   av_packet_free(&pkt_);
-        if (frame_) av_frame_free(&frame_);
-        if (codec_ctx_) avcodec_free_context(&codec_ctx_);
-        if (fmt_)   avformat_close_input(&fmt_);
+int run_manifest_file(const Options& opt)
+{
+    std::vector<ManifestJob> jobs;
+    bool ok;
+    if (opt.manifest == "-") {
+        ok = read_manifest(std::cin, jobs);
+    } else {
+        std::ifstream in(opt.manifest);
+        ok = in && read_manifest(in, jobs);
+    }
+    if (!ok) {
+        std::cerr << "manifesto inválido: " << opt.manifest << '\n';
+        return EXIT_FAILURE;
     }
+    std::unique_ptr<ResultCache> cache;
+    if (!opt.cache_dir.empty()) cache = std::make_unique<ResultCache>(opt.cache_dir);
 
-    ~VideoFile() { close(); }
+    ManifestConfig cfg;
+    cfg.jobs = opt.jobs;
+    cfg.decoder = decoder_config(opt);
+    cfg.scale = opt.scale;
+    cfg.cache = cache.get();
+    ExtractResult r = run_manifest(jobs, cfg);
+    std::cout << r.written << " frames salvos de " << jobs.size() << " vídeos\n";
+    if (r.failed) std::cerr << r.failed << " frames falharam\n";
+    return r.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-private:
-    std::string path_;
-    AVFormatContext* fmt_{nullptr};
-    AVCodecContext*  codec_ctx_{nullptr};
-    AVFrame* frame_{nullptr};
-    AVPacket* pkt_{nullptr};
-    int stream_index_{-1};
-};
+// Executa o modo escolhido; main só cuida de argumentos e do relatório.
+int run(Options& opt)
+{
+    // O prazo de --deadline-ms conta desde aqui: abertura e seek inclusos.
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(opt.deadline_ms);
 
-/* ---------- Salva frame como PPM ---------- */
+    if (!opt.daemon.empty()) {
+        DecoderPool pool(opt.pool, decoder_config(opt));
+        std::unique_ptr<FrameCache> cache;
+        if (opt.frame_cache) {
+            cache = std::make_unique<FrameCache>(opt.frame_cache << 20);
+            pool.use_cache(cache.get());
+        }
+        return serve(opt.daemon, pool, opt.scale, cache.get());
+    }
 
-void save_ppm(const AVFrame* fr, const std::string& out)
-{
-    if (!fr) return;
-    FILE* f = std::fopen(out.c_str(), "wb");
-    if (!f) throw std::runtime_error("cannot open output");
-
-    // Converte para RGB24
-    SwsContext* sws = sws_getContext(
-        fr->width, fr->height, static_cast<AVPixelFormat>(fr->format),
-        fr->width, fr->height, AV_PIX_FMT_RGB24,
-        SWS_BILINEAR, nullptr, nullptr, nullptr);
-
-    AVFrame* rgb = av_frame_alloc();
-    rgb->format = AV_PIX_FMT_RGB24;
-    rgb->width  = fr->width;
-    rgb->height = fr->height;
-    av_frame_get_buffer(rgb, 0);
-
-    sws_scale(sws, fr->data, fr->linesize, 0, fr->height,
-              rgb->data, rgb->linesize);
-    sws_freeContext(sws);
-
-    fprintf(f, "P6\n%d %d\n255\n", fr->width, fr->height);
-    for (int y = 0; y < fr->height; ++y)
-        std::fwrite(rgb->data[0] + y * rgb->linesize[0], 1, fr->width * 3, f);
-
-    std::fclose(f);
-    av_frame_free(&rgb);
-}
+    if (opt.build_index) {
+        if (!FrameIndex::build(opt.video, opt.index)) {
+            std::cerr << "não consegui indexar o vídeo\n";
+            return EXIT_FAILURE;
+        }
+        std::cout << "índice salvo em " << opt.index << '\n';
+        return EXIT_SUCCESS;
+    }
 
-/* ---------- main ---------- */
+    if (!opt.dump.empty()) return run_dump(opt);
+    if (!opt.manifest.empty()) return run_manifest_file(opt);
 
-int main(int argc, char* argv[])
-{
-    if (argc != 4) {
-        std::cerr << "uso: " << argv[0] << " video.mp4 numero_frame out.ppm\n";
+    // Acertos no cache de resultados dispensam decodificar e até abrir o
+    // contêiner: o modo da chave sai das opções e do sidecar. O --batch
+    // sem --pipeline busca entre alvos distantes; o pipeline só avança.
+    std::unique_ptr<ResultCache> cache;
+    if (!opt.cache_dir.empty()) cache = std::make_unique<ResultCache>(opt.cache_dir);
+    const std::string mode =
+        cache_mode(opt.fast, opt.batch.empty() ? opt.seek : !opt.pipeline, opt.index);
+    std::vector<FrameRequest> reqs;
+    std::size_t cached = 0;
+    if (!opt.batch.empty()) {
+        if (!load_requests(opt, reqs)) {
+            std::cerr << "lista de frames inválida: " << opt.batch << '\n';
+            return EXIT_FAILURE;
+        }
+        if (cache) {
+            auto hit = [&](const FrameRequest& r) {
+                return cache->fetch(cache->key(opt.video, r.frame, opt.scale,
+                                               r.out, mode), r.out);
+            };
+            auto miss = std::remove_if(reqs.begin(), reqs.end(), hit);
+            cached = reqs.end() - miss;
+            reqs.erase(miss, reqs.end());
+        }
+        if (reqs.empty()) {
+            std::cout << cached << " frames salvos (" << cached << " do cache)\n";
+            return EXIT_SUCCESS;
+        }
+    } else if (cache &&
+               cache->fetch(cache->key(opt.video, opt.frame, opt.scale, opt.out, mode),
+                            opt.out)) {
+        std::cout << "frame salvo em " << opt.out << " (cache)\n";
+        return EXIT_SUCCESS;
+    }
+
+    // O sidecar torna o seek exato: usa-o sempre que existir.
+    FrameIndex idx;
+    if (idx.load(opt.index, opt.video)) opt.seek = true;
+    std::stable_sort(reqs.begin(), reqs.end(),
+        [](const FrameRequest& a, const FrameRequest& b) { return a.frame < b.frame; });
+
+    VideoFile vf(opt.video);
+    vf.use_index(&idx);
+    vf.fast_forward(opt.fast);
+    vf.threads(opt.threads, opt.thread_type);
+    vf.use_stats(opt.sink);
+    vf.input(opt.input);
+    if (!vf.open()) {
+        std::cerr << "não consegui abrir o vídeo\n";
         return EXIT_FAILURE;
     }
-    av_log_set_level(AV_LOG_QUIET);   // menos barulho
+    // Sem ele, o índice do contêiner já aberto, só se houver seek: um
+    // exato (sem reordenação) também torna o seek exato; um estimado só
+    // com --seek, que já numera pela taxa média.
+    const bool seeks = opt.seek ||
+        (opt.batch.empty() ? opt.frame > 0
+                           : seeks_within(reqs.begin(), reqs.end(), opt.seek_gap));
+    if (!idx.loaded() && seeks && vf.index_container(idx, opt.seek) && idx.exact())
+        opt.seek = true;
+    if (!opt.batch.empty())
+        return run_batch(opt, reqs, cached, vf, idx, cache.get(), mode);
 
-    VideoFile vf(argv[1]);
-    AVFrame* fr = get_nth_frame(vf, std::stoul(argv[2]));
+    AVFrame* fr;
+    if (opt.approx) {
+        fr = get_nearest_key(vf, opt.frame);
+    } else if (opt.deadline_ms) {
+        // sem o seek a passada linear come o prazo e devolve um frame
+        // qualquer do começo
+        if (opt.seek && !vf.seek(opt.frame)) {
+            std::cerr << "não consegui buscar o frame " << opt.frame << '\n';
+            return EXIT_FAILURE;
+        }
+        fr = get_nth_frame_by(vf, opt.frame, deadline);
+    } else {
+        fr = opt.seek ? seek_nth_frame(vf, opt.frame)
+                      : get_nth_frame(vf, opt.frame);
+    }
     if (!fr) {
         std::cerr << "frame não encontrado\n";
         return EXIT_FAILURE;
     }
-    save_ppm(fr, argv[3]);
-    std::cout << "frame salvo em " << argv[3] << '\n';
+    // Modo exato: outro frame (numeração que pulou o alvo) é erro, nunca
+    // resultado.
+    if (!opt.approx && !opt.deadline_ms && vf.position() != opt.frame) {
+        std::cerr << "frame " << opt.frame << " não encontrado (a decodificação chegou ao frame "
+                  << vf.position() << ")\n";
+        return EXIT_FAILURE;
+    }
+    ImageWriter write(opt.scale);
+    write.use_stats(opt.sink);
+    write(fr, opt.out);             // vf ainda aberta: fr é válido
+
+    // Aproximado ou sem tempo para chegar: outro frame, fora do cache.
+    if ((opt.approx || opt.deadline_ms) && vf.position() != opt.frame) {
+        long long off = static_cast<long long>(vf.position()) -
+                        static_cast<long long>(opt.frame);
+        std::cout << "frame salvo em " << opt.out << " (frame " << vf.position()
+                  << ", desvio " << (off > 0 ? "+" : "") << off << ")\n";
+        return EXIT_SUCCESS;
+    }
+    if (cache)
+        cache->store(cache->key(opt.video, opt.frame, opt.scale, opt.out, mode), opt.out);
+    std::cout << "frame salvo em " << opt.out << '\n';
     return EXIT_SUCCESS;
 }
 
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        std::cerr << "uso: " << argv[0]
+                  << " [--seek] [--fast] [--bisect] [--threads n|auto] [--thread-type frame|slice|both]\n"
+                  << "         [--approx] [--deadline-ms ms] [--mmap|--prefetch] [--stats]\n"
+                  << "         [--width w] [--height h] [--fit]"
+                  << " [--scaler point|fast-bilinear|bilinear|bicubic|area]\n"
+                  << "         [--index arq] [--cache-dir dir] video.mp4 numero_frame out.ppm|out.pgm\n"
+                  << "     " << argv[0]
+                  << " --build-index [--index arq] video.mp4\n"
+                  << "     " << argv[0]
+                  << " --batch lista.txt [--seek-gap n] [--fast] [--pipeline] [--index arq] [--cache-dir dir] video.mp4\n"
+                  << "     " << argv[0]
+                  << " --dump out/f%06d.ppm [--every k] [--jobs n] [--threads n] [--fast] video.mp4\n"
+                  << "     " << argv[0]
+                  << " --manifest lista.tsv [--jobs n] [--threads n|auto] [--cache-dir dir] [--fast]\n"
+                  << "     " << argv[0]
+                  << " --daemon socket [--pool n] [--frame-cache mb] [--seek-gap n] [--fast]\n";
+        return EXIT_FAILURE;
+    }
+    av_log_set_level(AV_LOG_QUIET);   // menos barulho
+
+    Stats stats;
+    if (opt.stats) opt.sink = &stats;
+    const uint64_t t0 = now_ns();
+    int rc = run(opt);
+    if (opt.stats) std::cerr << stats_json(stats, now_ns() - t0) << '\n';
+    return rc;
+}
@@ -0,0 +1,1011 @@
+/*
+ *  get_frame: motor de extração de frames (biblioteca)
+ *  Conceitos e algoritmos genéricos (EOP), o modelo VideoFile sobre o
+ *  FFmpeg, o índice de frames em sidecar e os gravadores PPM/PGM.
+ *  O executável get_frame é só uma linha de comando sobre isto.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+/* ---------- Conceitos (EOP) ---------- */
+
+// T satisfaz FrameSource se possuir:
+//   - open()     -> bool
+//   - read()     -> AVFrame*
+//   - position() -> std::size_t   (número do último frame lido)
+//   - close()    -> void
+// (definido informalmente aqui)
+//
+// T satisfaz SeekableFrameSource se, além disso, possuir:
+//   - seek(n)   -> bool       (o próximo read() devolve um frame de número <= n)
+//   - current() -> AVFrame*   (último frame lido, ainda válido, ou nullptr)
+//
+// get_nearest_key pede ainda:
+//   - nearest_key(n) -> std::size_t  (keyframe mais próximo de n)
+
+/* ---------- Abstração genérica ---------- */
+
+// Pré-condição: src aberta e o próximo frame tem número <= n.
+// O chamador é dono do ciclo de vida de src: o frame devolvido só é
+// válido enquanto src estiver aberta e até o próximo read().
+template <typename Src>
+AVFrame* get_nth_frame(Src& src, std::size_t n)
+{
+    AVFrame* fr = nullptr;
+    while ((fr = src.read()) && src.position() < n)
+        ;                         // nullptr em EOF
+    return fr;
+}
+
+// Mesma pós-condição, mas salta para o keyframe anterior a n e decodifica
+// só o resto do GOP. Se a fonte não consegue buscar, cai na varredura linear.
+template <typename Src>
+AVFrame* seek_nth_frame(Src& src, std::size_t n)
+{
+    src.seek(n);                  // se falhar, segue linear da posição atual
+    return get_nth_frame(src, n);
+}
+
+// Frame n de uma fonte que já está em uso: reaproveita o frame atual se
+// for o pedido, decodifica adiante se n está até gap frames à frente e
+// busca (inclusive para trás) nos outros casos. Uma fonte ainda não lida
+// está antes do frame 0: também só busca se n estiver longe.
+template <typename Src>
+AVFrame* get_nth_frame_near(Src& src, std::size_t n, std::size_t gap)
+{
+    AVFrame* fr = src.current();
+    if (fr && src.position() == n) return fr;
+    const bool fresh = !fr && src.position() == 0;
+    if ((!fr && !fresh) || n < src.position() || n - src.position() > gap)
+        src.seek(n);
+    return get_nth_frame(src, n);
+}
+
+// Modo aproximado, para prévias: o keyframe mais próximo de n (antes ou
+// depois), com um único frame decodificado. O número do frame devolvido
+// é src.position(); o desvio em relação a n fica com o chamador.
+template <typename Src>
+AVFrame* get_nearest_key(Src& src, std::size_t n)
+{
+    src.seek(src.nearest_key(n));
+    return src.read();
+}
+
+// get_nth_frame com prazo: se o relógio passar de deadline antes de n,
+// devolve o último frame decodificado, o mais perto de n a que se chegou
+// (src.position() diz qual). O prazo é conferido entre frames.
+template <typename Src, typename Clock, typename Duration>
+AVFrame* get_nth_frame_by(Src& src, std::size_t n,
+                          std::chrono::time_point<Clock, Duration> deadline)
+{
+    AVFrame* fr = nullptr;
+    while ((fr = src.read()) && src.position() < n && Clock::now() < deadline)
+        ;                         // nullptr em EOF
+    return fr;
+}
+
+// Um pedido de extração: número do frame e onde entregá-lo.
+struct FrameRequest {
+    std::size_t frame;
+    std::string out;
+};
+
+// Atende todos os pedidos numa única passada para frente: salta (seek)
+// quando o próximo alvo está a mais de gap frames, senão decodifica direto.
+// Pedidos repetidos recebem o mesmo frame. f(fr, pedido) é chamada uma
+// vez por pedido, com fr nullptr se o frame não existe (EOF) ou se a
+// numeração passou por cima dele.
+// Pré-condição: [first, last) ordenado por frame; src aberta e ainda não
+// lida. Devolve quantos pedidos foram atendidos.
+template <typename Src, typename I, typename F>
+std::size_t get_frames(Src& src, I first, I last, std::size_t gap, F f)
+{
+    AVFrame* fr = nullptr;
+    bool eof = false;
+    std::size_t served = 0;
+    for (; first != last; ++first) {
+        std::size_t n = first->frame;
+        if (!eof && (!fr || src.position() < n)) {
+            // antes do primeiro read() position() é 0: o primeiro alvo
+            // também só busca se estiver longe
+            if (n - src.position() > gap) src.seek(n);
+            fr = get_nth_frame(src, n);
+            eof = !fr;
+        }
+        const bool hit = fr && src.position() == n;
+        f(hit ? fr : nullptr, *first);
+        if (hit) ++served;
+    }
+    return served;
+}
+
+// Se get_frames, partindo do começo, buscaria algum alvo de [first,
+// last) com esse gap: só então compensa montar um índice para o seek.
+template <typename I>
+bool seeks_within(I first, I last, std::size_t gap)
+{
+    std::size_t pos = 0;
+    for (; first != last; ++first) {
+        if (first->frame > pos + gap) return true;
+        pos = first->frame;
+    }
+    return false;
+}
+
+/* ---------- Índice de frames (sidecar) ---------- */
+
+// Arquivo binário ao lado do vídeo (video.mp4.gfidx), em ordem nativa de
+// bytes: um IndexHeader seguido de count IndexEntry, uma por frame, em
+// ordem de apresentação. Construído só com demux, sem decodificar.
+
+struct IndexHeader {
+    char     magic[8];       // "GFIDX01\n"
+    uint32_t version;
+    int32_t  stream_index;
+    int32_t  tb_num, tb_den; // time_base do stream
+    uint64_t file_size;      // identidade do vídeo indexado
+    int64_t  file_mtime;     // ns
+    uint64_t count;
+};
+
+struct IndexEntry {
+    int64_t  pts;
+    int64_t  pos;            // offset do pacote no arquivo, -1 se desconhecido
+    uint32_t key;            // número do keyframe que abre o GOP deste frame
+    uint32_t flags;          // bit 0: keyframe
+};
+
+static_assert(sizeof(IndexHeader) == 48, "layout do sidecar mudou");
+static_assert(sizeof(IndexEntry) == 24, "layout do sidecar mudou");
+
+constexpr uint32_t index_keyframe = 1;
+
+inline std::string index_path(const std::string& video)
+{
+    return video + ".gfidx";
+}
+
+// Índice mapeado em memória (sidecar) ou montado do índice do próprio
+// contêiner; lookup frame -> keyframe em O(1).
+class FrameIndex {
+public:
+    FrameIndex() = default;
+    ~FrameIndex() { unload(); }
+
+    FrameIndex(const FrameIndex&) = delete;
+    FrameIndex& operator=(const FrameIndex&) = delete;
+
+    // Mapeia o sidecar se ele ainda descreve o vídeo (tamanho e mtime).
+    bool load(const std::string& sidecar, const std::string& video);
+
+    // Monta o índice em memória do que o demuxer aberto em fmt já leu no
+    // cabeçalho para o stream, sem ler pacotes nem decodificar: a tabela
+    // de amostras do MP4/MOV (stss/stts: uma entrada por frame) ou, se
+    // estimated, os cues do Matroska (só keyframes; os outros frames saem
+    // da taxa média, como no seek sem índice). O matroska só carrega os
+    // cues no primeiro seek: nesse caso fmt volta ao começo. false se o
+    // contêiner não tiver índice. Use via VideoFile::index_container.
+    bool from_container(AVFormatContext* fmt, int stream, bool estimated);
+
+    // Exato: sidecar, ou tabela de amostras sem frames B que começa no
+    // primeiro frame, que numera os frames como a contagem. Um índice
+    // estimado (cues, ou amostras com frames B) só escolhe keyframes: o
+    // VideoFile numera pela taxa média, e frames além do fim estimado
+    // seguem alcançáveis.
+    bool exact() const { return exact_; }
+
+    void unload();
+
+    bool loaded() const { return entries_ != nullptr; }
+    std::size_t size() const { return count_; }
+    int stream_index() const { return stream_; }
+    AVRational time_base() const { return tb_; }
+
+    const IndexEntry& operator[](std::size_t n) const { return entries_[n]; }
+
+    // Número do frame com esse pts (o mais próximo, se não houver igual).
+    std::size_t find(int64_t pts) const;
+
+    // Keyframe mais próximo do frame n, o que abre o seu GOP ou o que abre
+    // o seguinte; no empate, o anterior.
+    std::size_t nearest_key(std::size_t n) const;
+
+    // Uma passada de demux sobre o primeiro stream de vídeo.
+    static bool build(const std::string& video, const std::string& sidecar);
+
+private:
+    void* map_{nullptr};
+    std::size_t map_size_{0};
+    std::vector<IndexEntry> owned_;       // índice do contêiner
+    const IndexEntry* entries_{nullptr};
+    std::size_t count_{0};
+    int stream_{-1};
+    AVRational tb_{0, 1};
+    bool exact_{false};
+};
+
+/* ---------- Medições ---------- */
+
+// Contadores de uma execução, com tempos em ns de relógio monotônico.
+// Atômicos: nos modos com várias threads elas somam no mesmo Stats (os
+// tempos viram soma entre threads, não tempo de parede).
+struct Stats {
+    std::atomic<uint64_t> open_ns{0};         // avformat_open_input, avcodec_open2
+    std::atomic<uint64_t> probe_ns{0};        // avformat_find_stream_info
+    std::atomic<uint64_t> seek_ns{0};
+    std::atomic<uint64_t> demux_ns{0};        // av_read_frame
+    std::atomic<uint64_t> decode_ns{0};       // send/receive
+    std::atomic<uint64_t> convert_ns{0};      // swscale, kernels, luma
+    std::atomic<uint64_t> write_ns{0};
+    std::atomic<uint64_t> seeks{0};
+    std::atomic<uint64_t> packets{0};         // lidos do stream de vídeo
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> packets_decoded{0}; // entregues ao decodificador
+    std::atomic<uint64_t> frames_decoded{0};
+    std::atomic<uint64_t> frames_written{0};  // imagens gravadas
+};
+
+inline uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline void bump(Stats* s, std::atomic<uint64_t> Stats::*field, uint64_t n = 1)
+{
+    if (s) (s->*field).fetch_add(n, std::memory_order_relaxed);
+}
+
+// Soma a duração do escopo no campo; sem Stats não lê o relógio.
+class StageTimer {
+public:
+    StageTimer(Stats* s, std::atomic<uint64_t> Stats::*field)
+        : s_(s), field_(field), t0_(s ? now_ns() : 0) {}
+    ~StageTimer() { if (s_) bump(s_, field_, now_ns() - t0_); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Stats* s_;
+    std::atomic<uint64_t> Stats::*field_;
+    uint64_t t0_;
+};
+
+// Objeto JSON (uma linha) com os contadores, o tempo total e o pico de
+// RSS do processo. Quadros decodificados além dos gravados saem como
+// frames_skipped; pacotes que não renderam frame (descartados no avanço
+// rápido) como frames_dropped.
+std::string stats_json(const Stats& s, uint64_t total_ns);
+
+/* ---------- Camadas de entrada ---------- */
+
+// Como o VideoFile lê o arquivo: pelo protocolo file do libavformat, por
+// MmapInput ou por PrefetchInput.
+enum class InputMode { file, mmap, prefetch };
+
+// Entrada própria servida ao libavformat por um AVIOContext, que recebe
+// dicas dos trechos que o índice diz que serão lidos.
+class InputLayer {
+public:
+    virtual ~InputLayer() = default;
+    virtual AVIOContext* avio() const = 0;
+    virtual void will_need(int64_t pos, std::size_t len) = 0;  // em breve
+};
+
+// Abre path no modo pedido; nullptr para InputMode::file ou se a camada
+// não puder ser montada (quem chama segue pelo caminho normal).
+std::unique_ptr<InputLayer> open_input(InputMode mode, const std::string& path);
+
+// Arquivo local mapeado inteiro (mmap): cada leitura do demuxer vira um
+// memcpy do mapeamento, sem read(2) nem lseek(2). O kernel recebe
+// MADV_SEQUENTIAL na abertura e MADV_WILLNEED para o trecho de cada seek.
+class MmapInput : public InputLayer {
+public:
+    MmapInput() = default;
+    ~MmapInput() override { close(); }
+
+    MmapInput(const MmapInput&) = delete;
+    MmapInput& operator=(const MmapInput&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    AVIOContext* avio() const override { return avio_; }
+    void will_need(int64_t pos, std::size_t len) override;
+    std::size_t size() const { return size_; }
+
+private:
+    static int read(void* opaque, uint8_t* buf, int n);
+    static int64_t seek(void* opaque, int64_t offset, int whence);
+
+    uint8_t* data_{nullptr};
+    std::size_t size_{0};
+    std::size_t pos_{0};
+    AVIOContext* avio_{nullptr};
+};
+
+// Readahead assíncrono do processo inteiro: um só anel io_uring,
+// compartilhado por todos os arquivos abertos, recebe pedidos
+// IORING_OP_FADVISE(WILLNEED) e quem pede não espera o disco. Sem
+// io_uring (kernel antigo, seccomp) usa posix_fadvise.
+class Prefetcher {
+public:
+    static Prefetcher& instance();
+
+    void advise(int fd, int64_t pos, std::size_t len);
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+private:
+    Prefetcher();
+    ~Prefetcher();
+
+    struct Ring;                  // anel mapeado, em prefetch_input.cpp
+    std::unique_ptr<Ring> ring_;  // nullptr: sem io_uring
+};
+
+// Leitura por pread(2) com readahead adiante da posição corrente e nos
+// trechos dos seeks, ambos pedidos ao Prefetcher: o demuxer encontra os
+// dados já no page cache em vez de parar no disco frio.
+class PrefetchInput : public InputLayer {
+public:
+    PrefetchInput() = default;
+    ~PrefetchInput() override { close(); }
+
+    PrefetchInput(const PrefetchInput&) = delete;
+    PrefetchInput& operator=(const PrefetchInput&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    AVIOContext* avio() const override { return avio_; }
+    void will_need(int64_t pos, std::size_t len) override;
+
+private:
+    static int read(void* opaque, uint8_t* buf, int n);
+    static int64_t seek(void* opaque, int64_t offset, int whence);
+
+    int fd_{-1};
+    int64_t size_{0};
+    int64_t pos_{0};
+    int64_t ahead_{0};            // readahead já pedido até aqui
+    AVIOContext* avio_{nullptr};
+};
+
+/* ---------- Modelo concreto que satisfaz FrameSource ---------- */
+
+class VideoFile {
+public:
+    explicit VideoFile(const std::string& path) : path_(path) {}
+    ~VideoFile() { close(); }
+
+    VideoFile(const VideoFile&) = delete;
+    VideoFile& operator=(const VideoFile&) = delete;
+
+    // Índice opcional (não é dono); deve ser associado antes de open().
+    void use_index(const FrameIndex* idx) { index_ = idx; }
+
+    // Sem sidecar: monta idx do índice do contêiner já aberto (depois de
+    // open(), antes da primeira leitura) e passa a usá-lo, se exato ou se
+    // estimated. Não relê o arquivo, mas pode custar o seek que carrega os
+    // cues: chame só quando for buscar.
+    bool index_container(FrameIndex& idx, bool estimated);
+
+    // Medições opcionais (não é dono), antes de open().
+    void use_stats(Stats* s) { stats_ = s; }
+
+    // Camada de entrada (InputMode), antes de open(). Se a camada não
+    // puder ser montada, segue pelo protocolo file do libavformat.
+    void input(InputMode mode) { input_mode_ = mode; }
+
+    // Threads do decodificador, antes de open(): count 0 = automático (um
+    // por núcleo); type é FF_THREAD_FRAME, FF_THREAD_SLICE ou os dois.
+    // Threads por frame atrasam a saída em até count frames.
+    void threads(int count, int type)
+    {
+        thread_count_ = count;
+        thread_type_  = type;
+    }
+
+    // Avanço rápido: até o alvo do último seek, o decodificador descarta
+    // frames que não servem de referência. Do alvo em diante volta à
+    // qualidade total. Exige numeração por pts. O deblocking não é pulado:
+    // o seek sempre cai no GOP do alvo, cujos frames de referência o alvo
+    // usa.
+    void fast_forward(bool on) { fast_ = on; }
+
+    bool open();
+
+    // Máquina de estados send/receive: primeiro esgota os frames que o
+    // decodificador já tem (um pacote pode render vários, e eles ficam
+    // guardados entre chamadas); só então alimenta o próximo pacote. No
+    // fim do arquivo envia o pacote nulo e drena até AVERROR_EOF.
+    AVFrame* read();   // retorna nullptr em EOF ou erro
+
+    std::size_t position() const { return pos_; }
+    AVFrame* current() const { return has_frame_ ? frame_ : nullptr; }
+
+    // Busca o keyframe em ou antes de n. Com índice exato, o keyframe e o
+    // pts são exatos; sem ele, n vira timestamp pela taxa média do stream
+    // (assume CFR), e um índice estimado só escolhe o keyframe. Sem índice,
+    // em MPEG-TS/PS (timestamps descontínuos, seek do demuxer no meio de
+    // GOPs) o seek bissecciona os bytes do arquivo: cada sonda salta para
+    // um offset e lê até o primeiro keyframe com pts, e o intervalo se
+    // fecha no último keyframe com pts <= alvo, em O(log tamanho) sondas
+    // de no máximo um GOP cada. O pouso é conferido: se o demuxer não cai
+    // num keyframe com pts até o do alvo, recua, bissecciona ou volta ao
+    // começo. Depois do seek o número de cada frame vem do seu pts.
+    bool seek(std::size_t n);
+
+    // Keyframe mais próximo de n pelo índice; sem índice, o próprio n
+    // (o seek já cai no keyframe anterior).
+    std::size_t nearest_key(std::size_t n) const
+    {
+        return index_ ? index_->nearest_key(n) : n;
+    }
+
+    void close();
+
+    // Estágios separados, para pipelines: demux() e demux_seek() só tocam
+    // o demuxer, send()/receive()/flush() só o decodificador, e cada lado
+    // pode ficar numa thread. Não se misturam com read()/seek().
+    bool demux(AVPacket* p);              // próximo pacote do stream de vídeo
+    bool demux_seek(std::size_t key);     // keyframe key do índice
+    bool send(const AVPacket* p);         // nullptr começa a drenagem
+    AVFrame* receive();                   // nullptr: quer pacote ou acabou
+    void flush();                         // depois de um demux_seek
+
+    // Alvo do avanço rápido sem seek(): com fast_forward, send() descarta
+    // os frames sem referência numerados antes de n.
+    void aim(std::size_t n) { target_ = n; }
+
+private:
+    bool next_packet();
+    bool pts_numbering() const;
+    std::size_t number_of(int64_t ts) const;
+    void discard_before_target(const AVPacket* p);
+    int64_t frame_to_pts(std::size_t n) const;
+    std::size_t pts_to_frame(int64_t ts) const;
+    void count(const AVFrame* fr);
+    void prefetch(std::size_t key, std::size_t n) const;
+    bool seek_to(int64_t ts, int64_t pos, int64_t want);
+    bool land(int64_t ts, int64_t want);
+    bool landed(int64_t want);
+    bool rewind();
+    bool seek_demuxer(int64_t ts, int flags);
+    bool ts_seek_reliable() const;
+    bool can_bisect() const;
+    bool bisect(int64_t ts);
+    bool probe_key(int64_t from, int64_t limit, int64_t& pos, int64_t& pts);
+
+    std::string path_;
+    AVFormatContext* fmt_{nullptr};
+    AVCodecContext*  codec_ctx_{nullptr};
+    AVFrame* frame_{nullptr};
+    AVPacket* pkt_{nullptr};
+    int stream_index_{-1};
+    AVRational rate_{0, 1};      // taxa média do stream, fixada em open()
+    int64_t start_{0};           // pts do primeiro frame
+    AVRational tb_{0, 1};
+    const FrameIndex* index_{nullptr};
+    Stats* stats_{nullptr};
+    InputMode input_mode_{InputMode::file};
+    std::unique_ptr<InputLayer> input_;
+    std::size_t pos_{0};     // número do último frame devolvido
+    std::size_t next_{0};    // número do próximo frame, se não houver resync
+    bool resync_{false};
+    bool draining_{false};
+    bool has_frame_{false};  // frame_ guarda o último frame devolvido
+    bool held_{false};       // pkt_ guarda o pacote que conferiu o seek
+    bool fast_{false};
+    int thread_count_{1};
+    int thread_type_{FF_THREAD_FRAME | FF_THREAD_SLICE};
+    std::size_t target_{0};      // alvo do último seek
+};
+
+/* ---------- Conversão YUV -> RGB24 ---------- */
+
+// Kernels da conversão direta; best_yuv_kernel() escolhe pela CPU (uma
+// consulta ao CPUID, na primeira chamada).
+enum class YuvKernel { scalar, sse41, avx2 };
+
+YuvKernel best_yuv_kernel();
+const char* yuv_kernel_name(YuvKernel k);
+
+// YUV420P, YUVJ420P ou NV12 de 8 bits para RGB24 em dst, no mesmo tamanho,
+// BT.601 (faixa cheia para YUVJ420P ou color_range JPEG), com a croma
+// repetida em cada bloco 2x2, como no caminho sem escala do swscale. O
+// resultado difere do swscale em poucas unidades por canal e é o mesmo
+// em todos os kernels. false, sem tocar em dst, para outros formatos; um
+// kernel que a CPU não tem cai para o melhor disponível.
+bool yuv_to_rgb24(const AVFrame* fr, uint8_t* dst, int dst_stride,
+                  YuvKernel k = best_yuv_kernel());
+
+/* ---------- Salva frame como PPM ---------- */
+
+// Tamanho e qualidade da saída. Com só uma dimensão, a outra segue o
+// aspecto da origem; com as duas, estica, a menos que fit peça para caber
+// em width x height mantendo o aspecto. flags é o algoritmo do swscale.
+struct ScaleSpec {
+    int width{0};
+    int height{0};
+    bool fit{false};
+    int flags{SWS_BILINEAR};
+};
+
+// Flags do swscale pelo nome; -1 se desconhecido.
+int scaler_flags(const std::string& name);
+
+void output_size(const ScaleSpec& sp, int sw, int sh, int& dw, int& dh);
+
+// Arquivo inteiro em memória, pronto para um único write().
+struct FileImage {
+    const uint8_t* data;
+    std::size_t size;
+};
+
+// Conversor para RGB24 reaproveitável entre frames: o SwsContext e o
+// buffer de destino só são refeitos quando geometria ou formato mudam.
+// Conversão e redução de tamanho acontecem no mesmo sws_scale, direto
+// num buffer sem padding com o cabeçalho PPM na frente: o arquivo sai
+// com um só write, sem frame intermediário nem cópia por linha.
+class RgbConverter {
+public:
+    explicit RgbConverter(const ScaleSpec& spec = ScaleSpec{}) : spec_(spec) {}
+    ~RgbConverter() { sws_freeContext(sws_); }
+
+    RgbConverter(const RgbConverter&) = delete;
+    RgbConverter& operator=(const RgbConverter&) = delete;
+
+    // A imagem devolvida pertence ao conversor e vale até a próxima chamada.
+    FileImage operator()(const AVFrame* fr);
+
+private:
+    static constexpr std::size_t data_offset = 64;
+
+    ScaleSpec spec_;
+    SwsContext* sws_{nullptr};
+    std::vector<uint8_t> buf_;
+};
+
+void save_ppm(const AVFrame* fr, const std::string& out, RgbConverter& conv);
+void save_ppm(const AVFrame* fr, const std::string& out);
+
+/* ---------- Salva luma como PGM ---------- */
+
+// Plano de 8 bits por pixel, sem dono: aponta para o frame de origem ou
+// para o buffer do conversor.
+struct GrayView {
+    const uint8_t* data;
+    int linesize;
+    int width;
+    int height;
+};
+
+// Reduz 2:1 nas duas direções (média 2x2); dst tem w/2 x h/2.
+void halve_plane(const uint8_t* src, int sls, int w, int h,
+                 uint8_t* dst, int dls);
+
+// Luma de 8 bits direto do plano 0, sem swscale, para formatos YUV (e
+// GRAY8) cujo plano 0 é o Y com um byte por pixel. Os valores saem como
+// estão no vídeo (faixa limitada 16-235 no vídeo comum). Reduções são
+// feitas por médias 2x2 sucessivas e, se sobrar fração, amostragem do
+// pixel mais próximo; o algoritmo de ScaleSpec não se aplica. Outros
+// formatos caem no swscale para GRAY8.
+class GrayConverter {
+public:
+    explicit GrayConverter(const ScaleSpec& spec = ScaleSpec{}) : spec_(spec) {}
+    ~GrayConverter();
+
+    GrayConverter(const GrayConverter&) = delete;
+    GrayConverter& operator=(const GrayConverter&) = delete;
+
+    static bool direct_luma(int format);
+
+    // A vista devolvida vale até a próxima chamada e enquanto fr viver.
+    GrayView operator()(const AVFrame* fr);
+
+private:
+    uint8_t* buffer(int k, int w, int h);
+    GrayView swscale(const AVFrame* fr, int w, int h);
+
+    ScaleSpec spec_;
+    std::vector<uint8_t> buf_[2];
+    std::vector<int> xmap_;
+    SwsContext* sws_{nullptr};
+    AVFrame* gray_{nullptr};
+};
+
+void save_pgm(const AVFrame* fr, const std::string& out, GrayConverter& conv);
+
+// Grava uma luma já convertida como PGM.
+void save_gray(const GrayView& g, const std::string& out);
+
+/* ---------- Escolha do formato de saída ---------- */
+
+inline bool is_pgm(const std::string& out)
+{
+    return out.size() >= 4 && out.compare(out.size() - 4, 4, ".pgm") == 0;
+}
+
+// Grava pela extensão: .pgm só com a luma, qualquer outra como PPM.
+// Guarda os dois conversores para reaproveitá-los entre frames.
+class ImageWriter {
+public:
+    explicit ImageWriter(const ScaleSpec& spec = ScaleSpec{})
+        : rgb_(spec), gray_(spec) {}
+
+    // Medições opcionais (não é dono): conversão, escrita e imagens.
+    void use_stats(Stats* s) { stats_ = s; }
+
+    void operator()(const AVFrame* fr, const std::string& out);
+
+    // O arquivo inteiro (cabeçalho e pixels) num buffer próprio, para ser
+    // gravado depois com save_file, inclusive em outra thread.
+    std::vector<uint8_t> encode(const AVFrame* fr, const std::string& out);
+
+private:
+    RgbConverter rgb_;
+    GrayConverter gray_;
+    Stats* stats_{nullptr};
+};
+
+// Grava bytes em out com um único writev.
+void save_file(const std::string& out, const std::vector<uint8_t>& bytes);
+
+/* ---------- Cache de frames decodificados ---------- */
+
+struct FrameCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t insertions{0};
+    uint64_t evictions{0};
+    std::size_t bytes{0};        // soma dos buffers referenciados
+    std::size_t entries{0};
+};
+
+// Frames decodificados por (arquivo, número), com orçamento em bytes e
+// descarte LRU. Guarda referências (av_frame_ref), sem copiar pixels; os
+// frames saem como shared_ptr e continuam válidos depois de despejados.
+// file identifica o conteúdo (caminho e versão): quem muda de versão
+// muda de chave. Seguro para uso entre threads.
+class FrameCache {
+public:
+    explicit FrameCache(std::size_t budget) : budget_(budget) {}
+
+    FrameCache(const FrameCache&) = delete;
+    FrameCache& operator=(const FrameCache&) = delete;
+
+    std::shared_ptr<AVFrame> find(const std::string& file, std::size_t n);
+
+    // Guarda uma nova referência a fr e a devolve. Frames maiores que o
+    // orçamento inteiro não ficam no cache.
+    std::shared_ptr<AVFrame> insert(const std::string& file, std::size_t n,
+                                    const AVFrame* fr);
+
+    FrameCacheStats stats() const;
+    std::size_t budget() const { return budget_; }
+    void clear();
+
+private:
+    struct Key {
+        std::string file;
+        std::size_t frame;
+        bool operator==(const Key& o) const
+        {
+            return frame == o.frame && file == o.file;
+        }
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const
+        {
+            return std::hash<std::string>()(k.file) ^ (k.frame * 0x9e3779b97f4a7c15ull);
+        }
+    };
+    struct Entry {
+        Key key;
+        std::shared_ptr<AVFrame> frame;
+        std::size_t bytes;
+    };
+
+    void evict_to(std::size_t budget);   // com mu_ travado
+
+    const std::size_t budget_;
+    mutable std::mutex mu_;
+    std::list<Entry> lru_;       // frente = mais recente
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> map_;
+    FrameCacheStats stats_;
+};
+
+/* ---------- Cache de resultados em disco ---------- */
+
+// Imagens já extraídas, endereçadas pelo conteúdo do pedido: identidade
+// do vídeo (dispositivo, inode, tamanho, mtime), número do frame,
+// parâmetros de saída e o modo de decodificação. Um acerto é entregue por
+// reflink ou cópia, sem decodificar: a saída é sempre um arquivo próprio,
+// gravável, nunca um alias do cache. Os arquivos do cache ficam somente
+// leitura.
+class ResultCache {
+public:
+    explicit ResultCache(std::string dir) : dir_(std::move(dir)) {}
+
+    // Chave do pedido; vazia se o vídeo não existir. mode distingue
+    // decodificações e numerações diferentes do mesmo n (cache_mode). A
+    // chave leva a versão do formato das imagens: outra versão não acerta.
+    std::string key(const std::string& video, std::size_t frame,
+                    const ScaleSpec& scale, const std::string& out,
+                    const std::string& mode = std::string()) const;
+
+    // Coloca o resultado de key em out; false se não estiver no cache.
+    bool fetch(const std::string& key, const std::string& out) const;
+
+    // Guarda out, já gravado, sob key (cópia atômica para dentro do cache).
+    bool store(const std::string& key, const std::string& out) const;
+
+private:
+    std::string path(const std::string& key) const;
+
+    std::string dir_;
+};
+
+// Parâmetro mode de ResultCache::key: decodificação (--fast descarta
+// frames) e numeração, decidida sem abrir o vídeo. Com o sidecar index
+// (tamanho e mtime entram no modo) o frame n é o do índice; sem ele, quem
+// busca (seeks) numera pelo pts ou pelo índice do contêiner, fixos para o
+// mesmo arquivo, e quem só avança conta os frames de saída.
+std::string cache_mode(bool fast, bool seeks, const std::string& index);
+
+/* ---------- Pool de decodificadores ---------- */
+
+// Como abrir cada VideoFile do pool.
+struct DecoderConfig {
+    bool fast{false};
+    int threads{1};
+    int thread_type{FF_THREAD_FRAME | FF_THREAD_SLICE};
+    std::size_t seek_gap{250};   // sem índice: distância que justifica seek
+    Stats* stats{nullptr};       // medições (não é dono)
+    InputMode input{InputMode::file};
+};
+
+// VideoFile abertos por caminho, com descarte LRU acima de capacity.
+// Cada entrada leva o índice do sidecar (se válido; senão o do contêiner,
+// se exato) e a identidade do arquivo: se o vídeo mudar no disco, é
+// reaberto. Um decodificador reaproveitado continua da posição onde
+// parou. Com um FrameCache associado, frames já decodificados não passam
+// de novo pelo decoder.
+class DecoderPool {
+public:
+    DecoderPool(std::size_t capacity, const DecoderConfig& cfg)
+        : capacity_(capacity ? capacity : 1), cfg_(cfg) {}
+
+    DecoderPool(const DecoderPool&) = delete;
+    DecoderPool& operator=(const DecoderPool&) = delete;
+
+    // VideoFile aberto para path, agora o mais recente; nullptr se não abre.
+    // O ponteiro vale até a próxima chamada que possa descartar entradas.
+    VideoFile* acquire(const std::string& path);
+
+    // Cache opcional (não é dono), compartilhável com outros pools.
+    void use_cache(FrameCache* cache) { cache_ = cache; }
+
+    // Frame n de path, do cache ou seguindo do ponto atual do decodificador
+    // quando n está logo adiante; position recebe o número do frame
+    // devolvido. Frames do cache valem enquanto houver referência; sem
+    // cache, o frame é do decodificador e vale até a próxima chamada.
+    std::shared_ptr<AVFrame> get(const std::string& path, std::size_t n,
+                                 std::size_t* position = nullptr);
+
+    std::size_t size() const { return lru_.size(); }
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    struct Entry {
+        std::string path;
+        uint64_t dev, ino, size;
+        int64_t mtime;
+        std::unique_ptr<FrameIndex> index;
+        std::unique_ptr<VideoFile> video;
+    };
+
+    static std::string cache_key(const Entry& e);
+
+    std::size_t capacity_;
+    DecoderConfig cfg_;
+    FrameCache* cache_{nullptr};
+    std::list<Entry> lru_;       // frente = mais recente
+    std::unordered_map<std::string, std::list<Entry>::iterator> map_;
+};
+
+/* ---------- Daemon ---------- */
+
+// Atende pedidos por um socket Unix (SOCK_STREAM), uma linha por pedido:
+//     video<TAB>numero_frame<TAB>saída
+// e responde "ok <frame>" com o número do frame gravado, ou
+// "err <motivo>". A linha "stats" devolve os contadores do cache de
+// frames do pool, se houver. Várias conexões são multiplexadas com poll;
+// os pedidos são executados um a um sobre o pool. Volta em
+// SIGINT/SIGTERM.
+int serve(const std::string& socket_path, DecoderPool& pool,
+          const ScaleSpec& scale, const FrameCache* cache = nullptr);
+
+/* ---------- Extração completa em paralelo ---------- */
+
+struct DumpConfig {
+    std::string pattern;         // saída com um "%d" (ex.: out/f%06d.ppm)
+    std::size_t every{1};        // grava os frames múltiplos de every
+    unsigned jobs{0};            // workers; 0 = um por núcleo
+    DecoderConfig decoder{false, 0};  // cada worker abre o seu; threads 0 = share_cpus
+    ScaleSpec scale;
+};
+
+struct ExtractResult {
+    std::size_t written{0};
+    std::size_t failed{0};
+};
+
+// Divide os núcleos entre workers e threads do codec para que
+// jobs * threads não passe de hardware_concurrency. Zero é "automático":
+// só threads fixo dá jobs = núcleos / threads, só jobs fixo dá
+// threads = núcleos / jobs, e nenhum dos dois dá um worker por núcleo.
+// Workers além de work (unidades de trabalho: vídeos, GOPs) nunca
+// rodariam: jobs é limitado a work antes da divisão, e os núcleos que
+// sobram vão para as threads.
+void share_cpus(unsigned& jobs, int& threads, std::size_t work);
+
+// Nome do frame n segundo pattern: o primeiro %d (com largura e zeros
+// opcionais, ex.: %06d) vira n; "%%" é um '%' literal.
+std::string frame_name(const std::string& pattern, std::size_t n);
+
+// pattern tem a conversão do número? Sem ela todos os frames iriam para o
+// mesmo arquivo, escritos ao mesmo tempo pelos workers.
+inline bool has_frame_number(const std::string& pattern)
+{
+    return frame_name(pattern, 0) != frame_name(pattern, 1);
+}
+
+// Grava todos os frames pedidos de video, dividindo o arquivo nos GOPs do
+// índice (obrigatório); pattern precisa de has_frame_number. Cada worker
+// decodifica GOPs com o seu VideoFile e o seu ImageWriter; a fila de cada
+// um começa com um trecho contíguo do vídeo e quem esvazia a sua rouba
+// GOPs do fim da fila dos outros.
+ExtractResult dump_frames(const std::string& video, const FrameIndex& index,
+                          const DumpConfig& cfg);
+
+// Pedidos de um vídeo dentro de um manifesto.
+struct ManifestJob {
+    std::string video;
+    std::vector<FrameRequest> reqs;
+};
+
+// Lê linhas "video<TAB>numero_frame<TAB>saída", agrupando os pedidos por
+// vídeo na ordem em que cada vídeo aparece; linhas vazias e começadas
+// por '#' são ignoradas.
+bool read_manifest(std::istream& in, std::vector<ManifestJob>& jobs);
+
+struct ManifestConfig {
+    unsigned jobs{0};            // workers; 0 = automático (share_cpus)
+    DecoderConfig decoder{false, 0};  // threads 0 = automático (share_cpus)
+    ScaleSpec scale;
+    const ResultCache* cache{nullptr};
+};
+
+// Atende o manifesto num pool fixo de workers, um vídeo por vez em cada:
+// índice do sidecar se válido, pedidos ordenados e uma passada com
+// get_frames. Sem processos novos nem reabrir o vídeo por frame.
+ExtractResult run_manifest(const std::vector<ManifestJob>& jobs,
+                           const ManifestConfig& cfg);
+
+/* ---------- Pipeline em estágios ---------- */
+
+// Fila limitada sem locks para um produtor e um consumidor. Cada lado só
+// escreve o seu índice e guarda uma cópia do índice do outro, relida só
+// quando a fila parece cheia (ou vazia). push/pop esperam girando e depois
+// cedendo a CPU: fila cheia segura o produtor (backpressure).
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : mask_(round_up(capacity) - 1), ring_(mask_ + 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool try_push(T& v)           // v só é movido se couber
+    {
+        const std::size_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_seen_ > mask_) {
+            head_seen_ = head_.load(std::memory_order_acquire);
+            if (t - head_seen_ > mask_) return false;
+        }
+        ring_[t & mask_] = std::move(v);
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& v)
+    {
+        const std::size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_seen_) {
+            tail_seen_ = tail_.load(std::memory_order_acquire);
+            if (h == tail_seen_) return false;
+        }
+        v = std::move(ring_[h & mask_]);
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T v)
+    {
+        for (unsigned spins = 0; !try_push(v);) wait(spins);
+    }
+
+    T pop()
+    {
+        T v;
+        for (unsigned spins = 0; !try_pop(v);) wait(spins);
+        return v;
+    }
+
+private:
+    static std::size_t round_up(std::size_t n)
+    {
+        std::size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static void wait(unsigned& spins)
+    {
+        if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    alignas(64) std::atomic<std::size_t> head_{0};   // do consumidor
+    std::size_t tail_seen_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};   // do produtor
+    std::size_t head_seen_{0};
+    alignas(64) const std::size_t mask_;
+    std::vector<T> ring_;
+};
+
+// Atende os pedidos com uma thread por estágio: demux -> decodificação ->
+// conversão -> escrita, ligadas por SpscQueue de depth itens. Leitura do
+// disco, demux e swscale correm enquanto o decodificador trabalha. Com
+// índice o demux pula direto para o GOP de cada pedido distante; sem ele
+// a passada é linear. Mesma semântica de get_frames: cada pedido recebe
+// o frame com o seu número, ou falha. done(pedido) roda na thread
+// de escrita a cada arquivo gravado; stats recebe conversão e escrita
+// (demux e decodificação vão para o Stats da própria vf).
+// Pré-condição: reqs ordenado por frame; vf aberta e ainda não lida.
+ExtractResult pipeline_frames(
+    VideoFile& vf, const FrameIndex& index, const std::vector<FrameRequest>& reqs,
+    const ScaleSpec& scale, std::size_t depth = 16,
+    const std::function<void(const FrameRequest&)>& done = nullptr,
+    Stats* stats = nullptr);
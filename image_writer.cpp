@@ -0,0 +1,324 @@
+/*
+ *  Gravadores de imagem: PPM (RGB24 via swscale) e PGM (luma direta).
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Grava os pedaços com writev, em lotes de até IOV_MAX, retomando escritas
+// parciais (iov é consumido). Cria ou trunca out.
+void write_file(const std::string& out, struct iovec* iov, int n)
+{
+    int fd = ::open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) throw std::runtime_error("cannot open output");
+    while (n > 0) {
+        ssize_t w = ::writev(fd, iov, std::min(n, IOV_MAX));
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd);
+            throw std::runtime_error("cannot write output");
+        }
+        std::size_t k = static_cast<std::size_t>(w);
+        for (; n > 0 && k >= iov->iov_len; k -= iov->iov_len, ++iov, --n)
+            ;
+        if (n > 0 && k > 0) {            // pedaço escrito pela metade
+            iov->iov_base = static_cast<char*>(iov->iov_base) + k;
+            iov->iov_len -= k;
+        }
+    }
+    if (::close(fd) < 0) throw std::runtime_error("cannot write output");
+}
+
+} // namespace
+
+/* ---------- Salva frame como PPM ---------- */
+
+int scaler_flags(const std::string& name)
+{
+    if (name == "point")         return SWS_POINT;
+    if (name == "fast-bilinear") return SWS_FAST_BILINEAR;
+    if (name == "bilinear")      return SWS_BILINEAR;
+    if (name == "bicubic")       return SWS_BICUBIC;
+    if (name == "area")          return SWS_AREA;
+    return -1;
+}
+
+void output_size(const ScaleSpec& sp, int sw, int sh, int& dw, int& dh)
+{
+    dw = sw;
+    dh = sh;
+    if (sp.width > 0 && sp.height > 0) {
+        dw = sp.width;
+        dh = sp.height;
+        if (sp.fit) {
+            // menor das duas escalas, comparando sem divisão
+            if (int64_t(sp.width) * sh <= int64_t(sp.height) * sw)
+                dh = static_cast<int>((int64_t(sh) * sp.width + sw / 2) / sw);
+            else
+                dw = static_cast<int>((int64_t(sw) * sp.height + sh / 2) / sh);
+        }
+    } else if (sp.width > 0) {
+        dw = sp.width;
+        dh = static_cast<int>((int64_t(sh) * sp.width + sw / 2) / sw);
+    } else if (sp.height > 0) {
+        dh = sp.height;
+        dw = static_cast<int>((int64_t(sw) * sp.height + sh / 2) / sh);
+    }
+    dw = std::max(dw, 1);
+    dh = std::max(dh, 1);
+}
+
+FileImage RgbConverter::operator()(const AVFrame* fr)
+{
+    int w, h;
+    output_size(spec_, fr->width, fr->height, w, h);
+
+    // Os pixels começam em data_offset (alinhado); o cabeçalho fica
+    // encostado neles, logo antes.
+    char head[32];
+    int hlen = std::snprintf(head, sizeof head, "P6\n%d %d\n255\n", w, h);
+    std::size_t pixels = static_cast<std::size_t>(w) * h * 3;
+    buf_.resize(data_offset + pixels);
+    uint8_t* start = buf_.data() + data_offset - hlen;
+    std::memcpy(start, head, hlen);
+
+    // Sem escala, YUV 4:2:0 comum vai direto pelo kernel SIMD.
+    uint8_t* pix = buf_.data() + data_offset;
+    if (w == fr->width && h == fr->height && yuv_to_rgb24(fr, pix, w * 3))
+        return FileImage{start, hlen + pixels};
+
+    sws_ = sws_getCachedContext(
+        sws_, fr->width, fr->height, static_cast<AVPixelFormat>(fr->format),
+        w, h, AV_PIX_FMT_RGB24, spec_.flags, nullptr, nullptr, nullptr);
+    if (!sws_) throw std::runtime_error("cannot convert frame");
+    uint8_t* dst[4] = {pix, nullptr, nullptr, nullptr};
+    int stride[4] = {w * 3, 0, 0, 0};
+    sws_scale(sws_, fr->data, fr->linesize, 0, fr->height, dst, stride);
+    return FileImage{start, hlen + pixels};
+}
+
+void save_ppm(const AVFrame* fr, const std::string& out, RgbConverter& conv)
+{
+    if (!fr) return;
+    FileImage img = conv(fr);             // converte antes de criar o arquivo
+    struct iovec iov{const_cast<uint8_t*>(img.data), img.size};
+    write_file(out, &iov, 1);
+}
+
+void save_ppm(const AVFrame* fr, const std::string& out)
+{
+    RgbConverter conv;
+    save_ppm(fr, out, conv);
+}
+
+/* ---------- Salva luma como PGM ---------- */
+
+void halve_plane(const uint8_t* src, int sls, int w, int h,
+                 uint8_t* dst, int dls)
+{
+    const int dw = w / 2, dh = h / 2;
+    for (int y = 0; y < dh; ++y) {
+        const uint8_t* r0 = src + 2 * y * sls;
+        const uint8_t* r1 = r0 + sls;
+        uint8_t* d = dst + y * dls;
+        int x = 0;
+#if defined(__SSE2__)
+        // média vertical em bytes, horizontal em 16 bits; mesmo
+        // arredondamento do laço escalar
+        const __m128i lo  = _mm_set1_epi16(0x00ff);
+        const __m128i one = _mm_set1_epi16(1);
+        for (; x + 16 <= dw; x += 16) {
+            const __m128i* p0 = reinterpret_cast<const __m128i*>(r0 + 2 * x);
+            const __m128i* p1 = reinterpret_cast<const __m128i*>(r1 + 2 * x);
+            __m128i v0 = _mm_avg_epu8(_mm_loadu_si128(p0), _mm_loadu_si128(p1));
+            __m128i v1 = _mm_avg_epu8(_mm_loadu_si128(p0 + 1),
+                                      _mm_loadu_si128(p1 + 1));
+            __m128i s0 = _mm_add_epi16(_mm_and_si128(v0, lo), _mm_srli_epi16(v0, 8));
+            __m128i s1 = _mm_add_epi16(_mm_and_si128(v1, lo), _mm_srli_epi16(v1, 8));
+            s0 = _mm_srli_epi16(_mm_add_epi16(s0, one), 1);
+            s1 = _mm_srli_epi16(_mm_add_epi16(s1, one), 1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x),
+                             _mm_packus_epi16(s0, s1));
+        }
+#endif
+        for (; x < dw; ++x) {
+            int a = (r0[2 * x]     + r1[2 * x]     + 1) >> 1;
+            int b = (r0[2 * x + 1] + r1[2 * x + 1] + 1) >> 1;
+            d[x] = static_cast<uint8_t>((a + b + 1) >> 1);
+        }
+    }
+}
+
+GrayConverter::~GrayConverter()
+{
+    sws_freeContext(sws_);
+    av_frame_free(&gray_);
+}
+
+bool GrayConverter::direct_luma(int format)
+{
+    const AVPixFmtDescriptor* d =
+        av_pix_fmt_desc_get(static_cast<AVPixelFormat>(format));
+    return d && !(d->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL |
+                              AV_PIX_FMT_FLAG_HWACCEL)) &&
+           d->comp[0].plane == 0 && d->comp[0].step == 1 &&
+           d->comp[0].offset == 0 && d->comp[0].depth == 8;
+}
+
+GrayView GrayConverter::operator()(const AVFrame* fr)
+{
+    int w, h;
+    output_size(spec_, fr->width, fr->height, w, h);
+    if (!direct_luma(fr->format)) return swscale(fr, w, h);
+
+    GrayView v{fr->data[0], fr->linesize[0], fr->width, fr->height};
+    int k = 0;
+    while (v.width >= 2 * w && v.height >= 2 * h) {
+        uint8_t* dst = buffer(k++, v.width / 2, v.height / 2);
+        halve_plane(v.data, v.linesize, v.width, v.height, dst, v.width / 2);
+        v = GrayView{dst, v.width / 2, v.width / 2, v.height / 2};
+    }
+    if (v.width == w && v.height == h) return v;
+
+    uint8_t* dst = buffer(k, w, h);
+    xmap_.resize(w);
+    for (int x = 0; x < w; ++x)
+        xmap_[x] = static_cast<int>(int64_t(2 * x + 1) * v.width / (2 * w));
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* s = v.data +
+            int64_t(2 * y + 1) * v.height / (2 * h) * v.linesize;
+        for (int x = 0; x < w; ++x) dst[y * w + x] = s[xmap_[x]];
+    }
+    return GrayView{dst, w, w, h};
+}
+
+// Dois buffers alternados bastam para a cadeia de reduções.
+uint8_t* GrayConverter::buffer(int k, int w, int h)
+{
+    std::vector<uint8_t>& b = buf_[k & 1];
+    b.resize(static_cast<std::size_t>(w) * h);
+    return b.data();
+}
+
+GrayView GrayConverter::swscale(const AVFrame* fr, int w, int h)
+{
+    sws_ = sws_getCachedContext(
+        sws_, fr->width, fr->height, static_cast<AVPixelFormat>(fr->format),
+        w, h, AV_PIX_FMT_GRAY8, spec_.flags, nullptr, nullptr, nullptr);
+    if (!sws_) throw std::runtime_error("cannot convert frame");
+    if (!gray_ || gray_->width != w || gray_->height != h) {
+        av_frame_free(&gray_);
+        gray_ = av_frame_alloc();
+        gray_->format = AV_PIX_FMT_GRAY8;
+        gray_->width  = w;
+        gray_->height = h;
+        if (av_frame_get_buffer(gray_, 0) < 0) {
+            av_frame_free(&gray_);
+            throw std::runtime_error("cannot allocate frame");
+        }
+    }
+    sws_scale(sws_, fr->data, fr->linesize, 0, fr->height,
+              gray_->data, gray_->linesize);
+    return GrayView{gray_->data[0], gray_->linesize[0], w, h};
+}
+
+void save_pgm(const AVFrame* fr, const std::string& out, GrayConverter& conv)
+{
+    if (!fr) return;
+    save_gray(conv(fr), out);
+}
+
+void save_gray(const GrayView& g, const std::string& out)
+{
+    // Um writev: cabeçalho e linhas apontando direto para o plano (um só
+    // pedaço se o plano não tem padding).
+    char head[32];
+    int hlen = std::snprintf(head, sizeof head, "P5\n%d %d\n255\n",
+                             g.width, g.height);
+    std::vector<struct iovec> iov;
+    iov.push_back(iovec{head, static_cast<std::size_t>(hlen)});
+    uint8_t* p = const_cast<uint8_t*>(g.data);
+    if (g.linesize == g.width) {
+        iov.push_back(iovec{p, static_cast<std::size_t>(g.width) * g.height});
+    } else {
+        for (int y = 0; y < g.height; ++y)
+            iov.push_back(iovec{p + static_cast<std::ptrdiff_t>(y) * g.linesize,
+                                static_cast<std::size_t>(g.width)});
+    }
+    write_file(out, iov.data(), static_cast<int>(iov.size()));
+}
+
+/* ---------- Escolha do formato de saída ---------- */
+
+// Mesmo caminho de save_ppm/save_pgm, medindo conversão e escrita à parte.
+void ImageWriter::operator()(const AVFrame* fr, const std::string& out)
+{
+    if (!fr) return;
+    if (is_pgm(out)) {
+        GrayView g{};
+        {
+            StageTimer t(stats_, &Stats::convert_ns);
+            g = gray_(fr);
+        }
+        StageTimer t(stats_, &Stats::write_ns);
+        save_gray(g, out);
+    } else {
+        FileImage img{};
+        {
+            StageTimer t(stats_, &Stats::convert_ns);
+            img = rgb_(fr);
+        }
+        StageTimer t(stats_, &Stats::write_ns);
+        struct iovec iov{const_cast<uint8_t*>(img.data), img.size};
+        write_file(out, &iov, 1);
+    }
+    bump(stats_, &Stats::frames_written);
+}
+
+/* ---------- Imagem em memória ---------- */
+
+std::vector<uint8_t> ImageWriter::encode(const AVFrame* fr, const std::string& out)
+{
+    StageTimer t(stats_, &Stats::convert_ns);
+    if (!is_pgm(out)) {
+        FileImage img = rgb_(fr);
+        return std::vector<uint8_t>(img.data, img.data + img.size);
+    }
+    GrayView g = gray_(fr);
+    char head[32];
+    int hlen = std::snprintf(head, sizeof head, "P5\n%d %d\n255\n",
+                             g.width, g.height);
+    std::vector<uint8_t> bytes(hlen + static_cast<std::size_t>(g.width) * g.height);
+    std::memcpy(bytes.data(), head, hlen);
+    uint8_t* d = bytes.data() + hlen;
+    for (int y = 0; y < g.height; ++y, d += g.width)
+        std::memcpy(d, g.data + static_cast<std::ptrdiff_t>(y) * g.linesize, g.width);
+    return bytes;
+}
+
+void save_file(const std::string& out, const std::vector<uint8_t>& bytes)
+{
+    struct iovec iov{const_cast<uint8_t*>(bytes.data()), bytes.size()};
+    write_file(out, &iov, 1);
+}
@@ -0,0 +1,127 @@
+/*
+ *  Manifesto de vários vídeos atendido por um pool fixo de workers.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+void run_job(const ManifestJob& job, const ManifestConfig& cfg, ImageWriter& write,
+             std::atomic<std::size_t>& written, std::atomic<std::size_t>& failed)
+{
+    // A chave do cache sai do sidecar, sem abrir o vídeo: um job todo em
+    // cache nem chega ao contêiner.
+    const std::string sidecar = index_path(job.video);
+    const std::string mode = cache_mode(cfg.decoder.fast, true, sidecar);
+
+    std::vector<FrameRequest> reqs;
+    reqs.reserve(job.reqs.size());
+    for (const FrameRequest& r : job.reqs) {
+        if (cfg.cache &&
+            cfg.cache->fetch(cfg.cache->key(job.video, r.frame, cfg.scale, r.out, mode),
+                             r.out))
+            ++written;
+        else
+            reqs.push_back(r);
+    }
+    if (reqs.empty()) return;     // tudo no cache: nem decodifica
+    std::stable_sort(reqs.begin(), reqs.end(),
+        [](const FrameRequest& a, const FrameRequest& b) { return a.frame < b.frame; });
+
+    FrameIndex idx;
+    idx.load(sidecar, job.video);
+    VideoFile vf(job.video);
+    vf.use_index(&idx);
+    vf.fast_forward(cfg.decoder.fast);
+    vf.input(cfg.decoder.input);
+    vf.threads(cfg.decoder.threads, cfg.decoder.thread_type);
+    vf.use_stats(cfg.decoder.stats);
+    if (!vf.open()) {
+        failed += reqs.size();
+        return;
+    }
+    // Sem sidecar, o índice do contêiner se for exato e houver seek.
+    if (!idx.loaded() && seeks_within(reqs.begin(), reqs.end(), cfg.decoder.seek_gap))
+        vf.index_container(idx, false);
+    get_frames(vf, reqs.begin(), reqs.end(),
+               idx.loaded() ? 0 : cfg.decoder.seek_gap,
+               [&](const AVFrame* fr, const FrameRequest& r) {
+                   if (!fr) {
+                       ++failed;
+                       return;
+                   }
+                   try {
+                       write(fr, r.out);
+                   } catch (const std::exception&) {
+                       ++failed;
+                       return;
+                   }
+                   ++written;
+                   if (cfg.cache)
+                       cfg.cache->store(cfg.cache->key(job.video, r.frame,
+                                                       cfg.scale, r.out, mode),
+                                        r.out);
+               });
+}
+
+} // namespace
+
+bool read_manifest(std::istream& in, std::vector<ManifestJob>& jobs)
+{
+    std::unordered_map<std::string, std::size_t> slot;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        std::size_t t1 = line.find('\t');
+        std::size_t t2 = t1 == std::string::npos ? t1 : line.find('\t', t1 + 1);
+        if (t2 == std::string::npos || t1 == 0 || t2 + 1 == line.size()) return false;
+        std::string frame = line.substr(t1 + 1, t2 - t1 - 1);
+        if (frame.empty() ||
+            frame.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        std::size_t n;
+        try {
+            n = std::stoul(frame);
+        } catch (const std::out_of_range&) {
+            return false;             // número que não cabe
+        }
+
+        std::string video = line.substr(0, t1);
+        auto it = slot.find(video);
+        if (it == slot.end()) {
+            it = slot.emplace(video, jobs.size()).first;
+            jobs.push_back(ManifestJob{video, {}});
+        }
+        jobs[it->second].reqs.push_back(
+            FrameRequest{n, line.substr(t2 + 1)});
+    }
+    return true;
+}
+
+ExtractResult run_manifest(const std::vector<ManifestJob>& jobs,
+                           const ManifestConfig& cfg)
+{
+    ManifestConfig c = cfg;
+    share_cpus(c.jobs, c.decoder.threads, jobs.size());
+    const std::size_t workers = c.jobs;
+
+    // Vídeos distribuídos sob demanda: quem termina pega o próximo.
+    std::atomic<std::size_t> next{0}, written{0}, failed{0};
+    auto worker = [&]() {
+        ImageWriter write(c.scale);
+        write.use_stats(c.decoder.stats);
+        for (std::size_t i; (i = next++) < jobs.size();)
+            run_job(jobs[i], c, write, written, failed);
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t w = 1; w < workers; ++w) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+    return ExtractResult{written.load(), failed.load()};
+}
@@ -0,0 +1,103 @@
+/*
+ *  MmapInput: AVIOContext de leitura sobre um arquivo mapeado.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+namespace {
+
+constexpr int avio_buffer_size = 64 * 1024;
+
+} // namespace
+
+bool MmapInput::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* m = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                     MAP_PRIVATE, fd, 0);
+    ::close(fd);                  // o mapeamento segue válido
+    if (m == MAP_FAILED) return false;
+    data_ = static_cast<uint8_t*>(m);
+    size_ = static_cast<std::size_t>(st.st_size);
+    pos_ = 0;
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+
+    auto* buf = static_cast<unsigned char*>(av_malloc(avio_buffer_size));
+    if (buf)
+        avio_ = avio_alloc_context(buf, avio_buffer_size, 0, this,
+                                   &MmapInput::read, nullptr, &MmapInput::seek);
+    if (!avio_) {
+        av_free(buf);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MmapInput::close()
+{
+    if (avio_) {
+        av_freep(&avio_->buffer);  // pode ter sido trocado pelo libavformat
+        avio_context_free(&avio_);
+    }
+    if (data_) ::munmap(data_, size_);
+    data_ = nullptr;
+    size_ = pos_ = 0;
+}
+
+void MmapInput::will_need(int64_t pos, std::size_t len)
+{
+    if (!data_ || pos < 0 || static_cast<std::size_t>(pos) >= size_) return;
+    const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t start = static_cast<std::size_t>(pos) & ~(page - 1);
+    std::size_t end = std::min(size_, static_cast<std::size_t>(pos) + len);
+    ::madvise(data_ + start, end - start, MADV_WILLNEED);
+}
+
+int MmapInput::read(void* opaque, uint8_t* buf, int n)
+{
+    auto* in = static_cast<MmapInput*>(opaque);
+    if (in->pos_ >= in->size_) return AVERROR_EOF;
+    std::size_t k = std::min(static_cast<std::size_t>(n), in->size_ - in->pos_);
+    std::memcpy(buf, in->data_ + in->pos_, k);
+    in->pos_ += k;
+    return static_cast<int>(k);
+}
+
+int64_t MmapInput::seek(void* opaque, int64_t offset, int whence)
+{
+    auto* in = static_cast<MmapInput*>(opaque);
+    int64_t base;
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE: return static_cast<int64_t>(in->size_);
+    case SEEK_SET:    base = 0; break;
+    case SEEK_CUR:    base = static_cast<int64_t>(in->pos_); break;
+    case SEEK_END:    base = static_cast<int64_t>(in->size_); break;
+    default:          return AVERROR(EINVAL);
+    }
+    int64_t to = base + offset;
+    if (to < 0) return AVERROR(EINVAL);
+    in->pos_ = static_cast<std::size_t>(to);  // além do fim: read dá EOF
+    return to;
+}
@@ -0,0 +1,225 @@
+/*
+ *  Pipeline de extração: demux, decodificação, conversão e escrita em
+ *  threads próprias, ligadas por filas SPSC.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+struct PacketItem {
+    AVPacket* pkt{nullptr};
+    bool flush{false};            // houve seek: limpa o decodificador
+    bool end{false};
+    std::size_t key{0};           // no flush: keyframe do novo trecho
+};
+
+struct FrameItem {
+    AVFrame* frame{nullptr};
+    std::size_t first{0};         // pedidos [first, last) recebem o frame
+    std::size_t last{0};
+    bool end{false};
+};
+
+struct ImageItem {
+    std::vector<uint8_t> bytes;
+    std::size_t req{0};
+    bool end{false};
+};
+
+// Trecho contínuo de decodificação: do keyframe key até o frame last.
+struct Run {
+    std::size_t key;
+    std::size_t last;
+};
+
+std::vector<Run> plan_runs(const FrameIndex& index, const std::vector<FrameRequest>& reqs)
+{
+    std::vector<Run> runs;
+    if (!index.loaded() || index.size() == 0) {
+        runs.push_back(Run{0, std::numeric_limits<std::size_t>::max()});
+        return runs;
+    }
+    for (const FrameRequest& r : reqs) {
+        std::size_t key = index[std::min(r.frame, index.size() - 1)].key;
+        if (!runs.empty() && runs.back().key == key)
+            runs.back().last = r.frame;
+        else
+            runs.push_back(Run{key, r.frame});
+    }
+    return runs;
+}
+
+// Lê pacotes trecho a trecho. Um trecho acaba no primeiro keyframe de GOP
+// depois de last; os pacotes seguintes com número menor que ele (frames
+// iniciais de GOP aberto) ainda são do trecho. Se o próximo trecho começa
+// nesse keyframe, segue sem seek.
+void demux_stage(VideoFile& vf, const FrameIndex& index, const std::vector<Run>& runs,
+                 SpscQueue<PacketItem>& out, const std::atomic<bool>& stop)
+{
+    const bool indexed = index.loaded();
+    std::size_t i = 0;
+    bool tail = false;
+    std::size_t boundary = 0;
+    if (indexed && runs[0].key > 0 && vf.demux_seek(runs[0].key))
+        out.push(PacketItem{nullptr, true, false, runs[0].key});
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        AVPacket* p = av_packet_alloc();
+        if (!p || !vf.demux(p)) {
+            av_packet_free(&p);
+            break;
+        }
+        bool numbered = indexed && p->pts != AV_NOPTS_VALUE;
+        std::size_t n = numbered ? index.find(p->pts) : 0;
+        if (tail) {
+            if (numbered && n > boundary) {        // fim do trecho: próximo
+                if (++i == runs.size()) {
+                    av_packet_free(&p);
+                    break;
+                }
+                tail = false;
+                if (vf.demux_seek(runs[i].key)) {
+                    av_packet_free(&p);
+                    out.push(PacketItem{nullptr, true, false, runs[i].key});
+                    continue;
+                }
+                // seek falhou: segue linear, sem perder o pacote
+            }
+        } else if (numbered && n < index.size() && index[n].key == n &&
+                   n > runs[i].last) {
+            if (i + 1 < runs.size() && runs[i + 1].key == n) {
+                ++i;                               // contíguo: sem seek
+            } else {
+                tail = true;
+                boundary = n;
+            }
+        }
+        out.push(PacketItem{p, false, false});
+    }
+    out.push(PacketItem{nullptr, false, true});
+}
+
+// Decodifica e entrega cópias (referências) dos frames pedidos; devolve
+// quantos pedidos foram atendidos. Com avanço rápido, o alvo é sempre o
+// próximo pedido pendente.
+std::size_t decode_stage(VideoFile& vf, const std::vector<FrameRequest>& reqs,
+                         SpscQueue<PacketItem>& in, SpscQueue<FrameItem>& out,
+                         std::atomic<bool>& stop)
+{
+    std::size_t next = 0, served = 0;
+    auto deliver = [&](const AVFrame* fr) {
+        const std::size_t pos = vf.position();
+        if (next == reqs.size() || reqs[next].frame > pos) return;
+        // pedidos que a numeração pulou ficam sem frame
+        while (next < reqs.size() && reqs[next].frame < pos) ++next;
+        std::size_t last = next;
+        while (last < reqs.size() && reqs[last].frame == pos) ++last;
+        if (last > next) {
+            out.push(FrameItem{av_frame_clone(fr), next, last, false});
+            served += last - next;
+            next = last;
+        }
+        if (next == reqs.size()) stop.store(true, std::memory_order_relaxed);
+        else vf.aim(reqs[next].frame);
+    };
+    // Esvazia o decodificador: frames retidos para reordenação ou pelas
+    // threads por frame ainda são do trecho corrente.
+    auto drain = [&] {
+        if (next == reqs.size()) return;
+        vf.send(nullptr);
+        while (AVFrame* fr = vf.receive()) deliver(fr);
+    };
+
+    vf.aim(reqs[0].frame);
+    for (;;) {
+        PacketItem it = in.pop();
+        if (it.end) break;
+        if (it.flush) {
+            drain();
+            vf.flush();
+            // Pedidos antes do novo trecho que o anterior não alcançou não
+            // existem: não recebem o primeiro frame do trecho seguinte.
+            while (next < reqs.size() && reqs[next].frame < it.key) ++next;
+            if (next < reqs.size()) vf.aim(reqs[next].frame);
+            continue;
+        }
+        if (next < reqs.size()) {
+            vf.send(it.pkt);      // erro: pula o pacote
+            while (AVFrame* fr = vf.receive()) deliver(fr);
+        }
+        av_packet_free(&it.pkt);  // depois de stop só esvazia a fila
+    }
+    drain();
+    out.push(FrameItem{nullptr, 0, 0, true});
+    return served;
+}
+
+void convert_stage(const std::vector<FrameRequest>& reqs, const ScaleSpec& scale,
+                   SpscQueue<FrameItem>& in, SpscQueue<ImageItem>& out,
+                   std::atomic<std::size_t>& failed, Stats* stats)
+{
+    ImageWriter writer(scale);
+    writer.use_stats(stats);
+    for (;;) {
+        FrameItem it = in.pop();
+        if (it.end) break;
+        for (std::size_t j = it.first; j < it.last; ++j) {
+            try {
+                if (!it.frame) throw std::runtime_error("cannot copy frame");
+                out.push(ImageItem{writer.encode(it.frame, reqs[j].out), j, false});
+            } catch (const std::exception&) {
+                ++failed;
+            }
+        }
+        av_frame_free(&it.frame);
+    }
+    out.push(ImageItem{{}, 0, true});
+}
+
+} // namespace
+
+ExtractResult pipeline_frames(
+    VideoFile& vf, const FrameIndex& index, const std::vector<FrameRequest>& reqs,
+    const ScaleSpec& scale, std::size_t depth,
+    const std::function<void(const FrameRequest&)>& done, Stats* stats)
+{
+    ExtractResult res;
+    if (reqs.empty()) return res;
+
+    const std::vector<Run> runs = plan_runs(index, reqs);
+    SpscQueue<PacketItem> packets(depth);
+    SpscQueue<FrameItem> frames(depth);
+    SpscQueue<ImageItem> images(depth);
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> failed{0};
+    std::size_t reached = 0;
+
+    std::thread demux([&] { demux_stage(vf, index, runs, packets, stop); });
+    std::thread decode([&] { reached = decode_stage(vf, reqs, packets, frames, stop); });
+    std::thread convert([&] { convert_stage(reqs, scale, frames, images, failed, stats); });
+
+    for (;;) {
+        ImageItem it = images.pop();
+        if (it.end) break;
+        try {
+            StageTimer t(stats, &Stats::write_ns);
+            save_file(reqs[it.req].out, it.bytes);
+        } catch (const std::exception&) {
+            ++failed;
+            continue;
+        }
+        ++res.written;
+        bump(stats, &Stats::frames_written);
+        if (done) done(reqs[it.req]);
+    }
+    demux.join();
+    decode.join();
+    convert.join();
+    res.failed = failed.load() + (reqs.size() - reached);
+    return res;
+}
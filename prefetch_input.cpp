@@ -0,0 +1,268 @@
+/*
+ *  PrefetchInput: AVIOContext por pread(2) com readahead assíncrono.
+ *  Prefetcher: anel io_uring do processo com IORING_OP_FADVISE.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define GET_FRAME_IO_URING 1
+#endif
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+namespace {
+
+constexpr int avio_buffer_size = 64 * 1024;
+constexpr int64_t readahead_window = 2 << 20;  // pedido adiante da leitura
+constexpr unsigned ring_entries = 64;
+
+void fadvise_now(int fd, int64_t pos, std::size_t len)
+{
+    ::posix_fadvise(fd, pos, static_cast<off_t>(len), POSIX_FADV_WILLNEED);
+}
+
+} // namespace
+
+/* ---------- Prefetcher ---------- */
+
+// Estado do anel io_uring; fica fora do cabeçalho instalado.
+struct Prefetcher::Ring {
+    ~Ring();
+    bool submit(int fd, int64_t pos, std::size_t len);
+    void reap();                  // com mu travado
+
+    std::mutex mu;
+    int fd{-1};
+    void* sq_ring{nullptr};
+    void* cq_ring{nullptr};
+    std::size_t sq_ring_size{0};
+    std::size_t cq_ring_size{0};
+    void* sqes{nullptr};
+    std::size_t sqes_size{0};
+    unsigned sq_entries{0};
+    // ponteiros para os campos dos anéis mapeados
+    unsigned* sq_head{nullptr};
+    unsigned* sq_tail{nullptr};
+    unsigned* sq_mask{nullptr};
+    unsigned* sq_array{nullptr};
+    unsigned* cq_head{nullptr};
+    unsigned* cq_tail{nullptr};
+};
+
+Prefetcher::Ring::~Ring()
+{
+    ::munmap(sqes, sqes_size);
+    if (cq_ring != sq_ring) ::munmap(cq_ring, cq_ring_size);
+    ::munmap(sq_ring, sq_ring_size);
+    ::close(fd);
+}
+
+// Descarta as conclusões: um WILLNEED que falhou só deixa de adiantar.
+void Prefetcher::Ring::reap()
+{
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    __atomic_store_n(cq_head, tail, __ATOMIC_RELEASE);
+}
+
+// O kernel executa IORING_OP_FADVISE(WILLNEED) nos seus workers: a
+// submissão volta sem esperar o disco, e o fd fica referenciado pelo
+// pedido mesmo que o arquivo seja fechado antes.
+bool Prefetcher::Ring::submit(int file, int64_t pos, std::size_t len)
+{
+#ifdef GET_FRAME_IO_URING
+    std::lock_guard<std::mutex> lock(mu);
+    reap();
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail;
+    if (tail - head >= sq_entries) return false;
+    unsigned i = tail & *sq_mask;
+    auto* sqe = static_cast<io_uring_sqe*>(sqes) + i;
+    std::memset(sqe, 0, sizeof *sqe);
+    sqe->opcode = IORING_OP_FADVISE;
+    sqe->fd = file;
+    sqe->off = static_cast<uint64_t>(pos);
+    sqe->len = static_cast<uint32_t>(std::min<std::size_t>(len, UINT32_MAX));
+    sqe->fadvise_advice = POSIX_FADV_WILLNEED;
+    sq_array[i] = i;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    if (::syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) >= 0)
+        return true;
+    // não foi aceito: desfaz e segue pelo caminho síncrono
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+#else
+    (void)file; (void)pos; (void)len;
+#endif
+    return false;
+}
+
+Prefetcher& Prefetcher::instance()
+{
+    static Prefetcher p;
+    return p;
+}
+
+Prefetcher::Prefetcher()
+{
+#ifdef GET_FRAME_IO_URING
+    io_uring_params p;
+    std::memset(&p, 0, sizeof p);
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, ring_entries, &p));
+    if (fd < 0) return;           // sem io_uring: posix_fadvise
+
+    std::size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    std::size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sq_size = cq_size = std::max(sq_size, cq_size);
+
+    void* sq = ::mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    void* cq = sq;
+    if (sq != MAP_FAILED && !single)
+        cq = ::mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    std::size_t sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = MAP_FAILED;
+    if (sq != MAP_FAILED && cq != MAP_FAILED)
+        sqes = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (cq != MAP_FAILED && cq != sq) ::munmap(cq, cq_size);
+        if (sq != MAP_FAILED) ::munmap(sq, sq_size);
+        ::close(fd);
+        return;
+    }
+
+    ring_.reset(new Ring);
+    Ring& r = *ring_;
+    r.fd = fd;
+    r.sq_ring = sq;
+    r.cq_ring = cq;
+    r.sq_ring_size = sq_size;
+    r.cq_ring_size = cq_size;
+    r.sqes = sqes;
+    r.sqes_size = sqes_size;
+    r.sq_entries = p.sq_entries;
+    auto* s = static_cast<char*>(sq);
+    auto* c = static_cast<char*>(cq);
+    r.sq_head = reinterpret_cast<unsigned*>(s + p.sq_off.head);
+    r.sq_tail = reinterpret_cast<unsigned*>(s + p.sq_off.tail);
+    r.sq_mask = reinterpret_cast<unsigned*>(s + p.sq_off.ring_mask);
+    r.sq_array = reinterpret_cast<unsigned*>(s + p.sq_off.array);
+    r.cq_head = reinterpret_cast<unsigned*>(c + p.cq_off.head);
+    r.cq_tail = reinterpret_cast<unsigned*>(c + p.cq_off.tail);
+#endif
+}
+
+Prefetcher::~Prefetcher() = default;
+
+void Prefetcher::advise(int fd, int64_t pos, std::size_t len)
+{
+    if (fd < 0 || pos < 0 || len == 0) return;
+    if (ring_ && ring_->submit(fd, pos, len)) return;
+    fadvise_now(fd, pos, len);
+}
+
+/* ---------- PrefetchInput ---------- */
+
+bool PrefetchInput::open(const std::string& path)
+{
+    close();
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) return false;
+    struct stat st;
+    if (::fstat(fd_, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close();
+        return false;
+    }
+    size_ = st.st_size;
+    pos_ = ahead_ = 0;
+    ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    auto* buf = static_cast<unsigned char*>(av_malloc(avio_buffer_size));
+    if (buf)
+        avio_ = avio_alloc_context(buf, avio_buffer_size, 0, this,
+                                   &PrefetchInput::read, nullptr,
+                                   &PrefetchInput::seek);
+    if (!avio_) {
+        av_free(buf);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PrefetchInput::close()
+{
+    if (avio_) {
+        av_freep(&avio_->buffer);  // pode ter sido trocado pelo libavformat
+        avio_context_free(&avio_);
+    }
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    size_ = pos_ = ahead_ = 0;
+}
+
+void PrefetchInput::will_need(int64_t pos, std::size_t len)
+{
+    if (fd_ < 0 || pos < 0 || pos >= size_) return;
+    Prefetcher::instance().advise(fd_, pos, len);
+}
+
+int PrefetchInput::read(void* opaque, uint8_t* buf, int n)
+{
+    auto* in = static_cast<PrefetchInput*>(opaque);
+    if (in->pos_ >= in->size_) return AVERROR_EOF;
+
+    // mantém uma janela pedida adiante; renova na metade
+    if (in->pos_ + readahead_window / 2 > in->ahead_) {
+        int64_t from = std::max(in->pos_, in->ahead_);
+        if (from < in->size_) {
+            Prefetcher::instance().advise(in->fd_, from,
+                                          static_cast<std::size_t>(readahead_window));
+            in->ahead_ = from + readahead_window;
+        }
+    }
+
+    ssize_t k;
+    do {
+        k = ::pread(in->fd_, buf, static_cast<std::size_t>(n), in->pos_);
+    } while (k < 0 && errno == EINTR);
+    if (k < 0) return AVERROR(errno);
+    if (k == 0) return AVERROR_EOF;
+    in->pos_ += k;
+    return static_cast<int>(k);
+}
+
+int64_t PrefetchInput::seek(void* opaque, int64_t offset, int whence)
+{
+    auto* in = static_cast<PrefetchInput*>(opaque);
+    int64_t base;
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE: return in->size_;
+    case SEEK_SET:    base = 0; break;
+    case SEEK_CUR:    base = in->pos_; break;
+    case SEEK_END:    base = in->size_; break;
+    default:          return AVERROR(EINVAL);
+    }
+    int64_t to = base + offset;
+    if (to < 0) return AVERROR(EINVAL);
+    if (to < in->pos_ || to > in->ahead_) in->ahead_ = to;  // janela recomeça
+    in->pos_ = to;
+    return to;
+}
@@ -0,0 +1,149 @@
+/*
+ *  ResultCache: imagens extraídas endereçadas pelo pedido, em disco.
+ */
+
+#include "get_frame.hpp"
+
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Versão dos bytes gravados: sobe quando a conversão ou os encoders mudam
+// a saída do mesmo pedido (2: kernels SIMD de ImageWriter).
+constexpr int format_version = 2;
+
+// FNV-1a de 64 bits; duas sementes dão os 128 bits da chave.
+uint64_t fnv1a(const std::string& s, uint64_t h)
+{
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// Reflink quando o sistema de arquivos deixa; senão copia os bytes.
+bool clone_or_copy(int from, int to)
+{
+    if (::ioctl(to, FICLONE, from) == 0) return true;
+    char buf[1 << 16];
+    for (;;) {
+        ssize_t r = ::read(from, buf, sizeof buf);
+        if (r == 0) return true;
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        for (ssize_t off = 0; off < r;) {
+            ssize_t w = ::write(to, buf + off, r - off);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            off += w;
+        }
+    }
+}
+
+// Cópia de from para um temporário ao lado de to, renomeado por cima.
+bool copy_file(const std::string& from, const std::string& to, mode_t mode)
+{
+    int in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    std::string tmp = to + ".tmp" + std::to_string(::getpid());
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd < 0) {
+        ::close(in);
+        return false;
+    }
+    bool ok = clone_or_copy(in, fd);
+    ::close(in);
+    ok = ::close(fd) == 0 && ok;
+    if (ok && ::rename(tmp.c_str(), to.c_str()) == 0) return true;
+    ::unlink(tmp.c_str());
+    return false;
+}
+
+} // namespace
+
+std::string ResultCache::key(const std::string& video, std::size_t frame,
+                             const ScaleSpec& scale, const std::string& out,
+                             const std::string& mode) const
+{
+    struct stat st;
+    if (::stat(video.c_str(), &st) < 0) return std::string();
+    std::string desc =
+        std::to_string(st.st_dev) + ':' + std::to_string(st.st_ino) + ':' +
+        std::to_string(st.st_size) + ':' + std::to_string(st.st_mtim.tv_sec) +
+        '.' + std::to_string(st.st_mtim.tv_nsec) +
+        "|frame=" + std::to_string(frame) +
+        "|fmt=" + (is_pgm(out) ? "pgm" : "ppm") +
+        "|size=" + std::to_string(scale.width) + 'x' + std::to_string(scale.height) +
+        (scale.fit ? "|fit" : "") +
+        "|sws=" + std::to_string(scale.flags) +
+        "|mode=" + mode +
+        "|v=" + std::to_string(format_version);
+    char hex[33];
+    std::snprintf(hex, sizeof hex, "%016llx%016llx",
+                  static_cast<unsigned long long>(fnv1a(desc, 0xcbf29ce484222325ull)),
+                  static_cast<unsigned long long>(fnv1a(desc, 0x84222325cbf29ce4ull)));
+    return std::string(hex) + (is_pgm(out) ? ".pgm" : ".ppm");
+}
+
+std::string cache_mode(bool fast, bool seeks, const std::string& index)
+{
+    std::string mode = fast ? "fast/" : "exact/";
+    struct stat st;
+    if (::stat(index.c_str(), &st) == 0)
+        return mode + "index@" + std::to_string(st.st_size) + ':' +
+               std::to_string(st.st_mtim.tv_sec) + '.' +
+               std::to_string(st.st_mtim.tv_nsec);
+    return mode + (seeks ? "seek" : "count");
+}
+
+// dir/ab/abcdef....ppm: dois níveis para não lotar um diretório só.
+std::string ResultCache::path(const std::string& key) const
+{
+    return dir_ + '/' + key.substr(0, 2) + '/' + key;
+}
+
+bool ResultCache::fetch(const std::string& key, const std::string& out) const
+{
+    if (key.empty()) return false;
+    const std::string src = path(key);
+    struct stat cs, os;
+    if (::stat(src.c_str(), &cs) < 0) return false;
+
+    // Saída que não é arquivo comum (ex.: /dev/stdout): escreve nela.
+    if (::stat(out.c_str(), &os) == 0 && !S_ISREG(os.st_mode)) {
+        int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) return false;
+        int fd = ::open(out.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+        bool ok = fd >= 0 && clone_or_copy(in, fd);
+        ::close(in);
+        if (fd >= 0) ok = ::close(fd) == 0 && ok;
+        return ok;
+    }
+
+    // Reflink, senão cópia; nunca hardlink, que deixaria a saída como um
+    // alias somente leitura do arquivo do cache.
+    return copy_file(src, out, 0666);
+}
+
+bool ResultCache::store(const std::string& key, const std::string& out) const
+{
+    if (key.empty()) return false;
+    const std::string dst = path(key);
+    std::string sub = dst.substr(0, dst.rfind('/'));
+    if ((::mkdir(dir_.c_str(), 0777) < 0 && errno != EEXIST) ||
+        (::mkdir(sub.c_str(), 0777) < 0 && errno != EEXIST))
+        return false;
+    return copy_file(out, dst, 0444);
+}
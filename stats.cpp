@@ -0,0 +1,54 @@
+/*
+ *  Relatório das medições em JSON.
+ */
+
+#include "get_frame.hpp"
+
+#include <sys/resource.h>
+
+namespace {
+
+void field(std::string& out, const char* name, uint64_t v)
+{
+    if (out.size() > 1) out += ", ";
+    out += '"';
+    out += name;
+    out += "\": ";
+    out += std::to_string(v);
+}
+
+} // namespace
+
+std::string stats_json(const Stats& s, uint64_t total_ns)
+{
+    auto get = [](const std::atomic<uint64_t>& a) {
+        return a.load(std::memory_order_relaxed);
+    };
+    const uint64_t decoded = get(s.frames_decoded), written = get(s.frames_written);
+    const uint64_t sent = get(s.packets_decoded);
+
+    struct rusage ru;
+    uint64_t rss = ::getrusage(RUSAGE_SELF, &ru) == 0
+                       ? static_cast<uint64_t>(ru.ru_maxrss) * 1024 : 0;   // KiB
+
+    std::string out = "{";
+    field(out, "total_ns", total_ns);
+    field(out, "open_ns", get(s.open_ns));
+    field(out, "probe_ns", get(s.probe_ns));
+    field(out, "seek_ns", get(s.seek_ns));
+    field(out, "demux_ns", get(s.demux_ns));
+    field(out, "decode_ns", get(s.decode_ns));
+    field(out, "convert_ns", get(s.convert_ns));
+    field(out, "write_ns", get(s.write_ns));
+    field(out, "seeks", get(s.seeks));
+    field(out, "packets", get(s.packets));
+    field(out, "bytes", get(s.bytes));
+    field(out, "packets_decoded", sent);
+    field(out, "frames_decoded", decoded);
+    field(out, "frames_written", written);
+    field(out, "frames_skipped", decoded > written ? decoded - written : 0);
+    field(out, "frames_dropped", sent > decoded ? sent - decoded : 0);
+    field(out, "peak_rss_bytes", rss);
+    out += '}';
+    return out;
+}
@@ -0,0 +1,426 @@
+/*
+ *  VideoFile: modelo de SeekableFrameSource sobre libavformat/libavcodec.
+ */
+
+#include "get_frame.hpp"
+
+#include <algorithm>
+
+std::unique_ptr<InputLayer> open_input(InputMode mode, const std::string& path)
+{
+    if (mode == InputMode::mmap) {
+        auto in = std::make_unique<MmapInput>();
+        if (in->open(path)) return in;
+    } else if (mode == InputMode::prefetch) {
+        auto in = std::make_unique<PrefetchInput>();
+        if (in->open(path)) return in;
+    }
+    return nullptr;
+}
+
+bool VideoFile::open()
+{
+    {
+        StageTimer t(stats_, &Stats::open_ns);
+        input_ = open_input(input_mode_, path_);
+        if (input_ && (fmt_ = avformat_alloc_context())) {
+            fmt_->pb = input_->avio();
+            fmt_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        } else {
+            input_.reset();       // protocolo file
+        }
+        if (avformat_open_input(&fmt_, path_.c_str(), nullptr, nullptr) < 0)
+            return false;         // fmt_ já liberado pelo libavformat
+    }
+
+    // Com índice, o layout do stream já é conhecido: pula o probe caro
+    // de avformat_find_stream_info se o cabeçalho basta para decodificar.
+    if (index_ && !index_->loaded()) index_ = nullptr;
+    if (index_) {
+        int i = index_->stream_index();
+        if (i >= 0 && static_cast<unsigned>(i) < fmt_->nb_streams &&
+            fmt_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+            stream_index_ = i;
+    }
+    const AVCodecParameters* par =
+        stream_index_ >= 0 ? fmt_->streams[stream_index_]->codecpar : nullptr;
+    if (!par || par->codec_id == AV_CODEC_ID_NONE || par->width <= 0) {
+        StageTimer t(stats_, &Stats::probe_ns);
+        if (avformat_find_stream_info(fmt_, nullptr) < 0)
+            return false;
+    }
+
+    if (stream_index_ == -1)
+        for (unsigned i = 0; i < fmt_->nb_streams; ++i)
+            if (fmt_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+                stream_index_ = static_cast<int>(i);
+                break;
+            }
+    if (stream_index_ == -1) return false;
+    if (index_ && (index_->stream_index() != stream_index_ ||
+                   av_cmp_q(index_->time_base(),
+                            fmt_->streams[stream_index_]->time_base) != 0))
+        index_ = nullptr;         // índice de outro layout: ignora
+
+    // Taxa, pts inicial e time_base ficam fixos daqui em diante: o lado do
+    // decodificador numera por eles sem tocar no fmt_, que a thread de
+    // demux do pipeline usa ao mesmo tempo.
+    const AVStream* st = fmt_->streams[stream_index_];
+    rate_  = av_guess_frame_rate(fmt_, fmt_->streams[stream_index_], nullptr);
+    start_ = st->start_time == AV_NOPTS_VALUE ? 0 : st->start_time;
+    tb_    = st->time_base;
+
+    const AVCodec* codec = avcodec_find_decoder(
+        fmt_->streams[stream_index_]->codecpar->codec_id);
+    if (!codec) return false;
+
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (!codec_ctx_) return false;
+    avcodec_parameters_to_context(
+        codec_ctx_, fmt_->streams[stream_index_]->codecpar);
+    codec_ctx_->thread_count = thread_count_;
+    codec_ctx_->thread_type  = thread_type_;
+    {
+        StageTimer t(stats_, &Stats::open_ns);
+        if (avcodec_open2(codec_ctx_, codec, nullptr) < 0) return false;
+    }
+
+    frame_ = av_frame_alloc();
+    pkt_   = av_packet_alloc();
+    return true;
+}
+
+bool VideoFile::index_container(FrameIndex& idx, bool estimated)
+{
+    if (!fmt_ || index_) return false;     // já tem o sidecar
+    if (!idx.from_container(fmt_, stream_index_, estimated) ||
+        !(idx.exact() || estimated)) {
+        idx.unload();
+        return false;
+    }
+    index_ = &idx;
+    return true;
+}
+
+AVFrame* VideoFile::read()
+{
+    for (;;) {
+        int ret;
+        {
+            StageTimer t(stats_, &Stats::decode_ns);
+            ret = avcodec_receive_frame(codec_ctx_, frame_);
+        }
+        if (ret == 0) {
+            count(frame_);
+            has_frame_ = true;
+            return frame_;   // devolve ponteiro "vivo" (não copia)
+        }
+        has_frame_ = false;  // receive já limpou frame_
+        if (ret != AVERROR(EAGAIN)) return nullptr;   // drenado ou erro
+
+        // Após EAGAIN no receive, o send sempre aceita o pacote.
+        if (!next_packet()) {
+            if (draining_) return nullptr;
+            send(nullptr);
+            draining_ = true;
+            continue;
+        }
+        send(pkt_);                               // erro: pula o pacote
+        av_packet_unref(pkt_);
+    }
+}
+
+bool VideoFile::seek(std::size_t n)
+{
+    if (!fmt_ || stream_index_ < 0) return false;
+    int64_t ts, want, pos = -1;
+    // Índice estimado: frames além do fim estimado vão pela taxa média.
+    if (index_ && (index_->exact() || n < index_->size())) {
+        if (n >= index_->size()) return false;
+        std::size_t key = (*index_)[n].key;
+        target_ = n;
+        if (!resync_ && key <= next_ && next_ <= n)
+            return true;          // já dentro do GOP do alvo
+        ts = (*index_)[key].pts;
+        pos = (*index_)[key].pos;
+        want = (*index_)[n].pts;
+        prefetch(key, n);
+    } else {
+        if (!pts_numbering()) return false;
+        ts = want = frame_to_pts(n);
+        target_ = n;
+    }
+
+    StageTimer t(stats_, &Stats::seek_ns);
+    bump(stats_, &Stats::seeks);
+    if (!seek_to(ts, pos, want)) return false;
+    avcodec_flush_buffers(codec_ctx_);
+    draining_ = false;
+    resync_ = true;
+    return true;
+}
+
+// Leva o demuxer a um keyframe com pts <= want, começando por ts (ou pelo
+// offset pos do keyframe no índice, onde o seek por timestamp falha). O seek
+// do libavformat não garante onde cai (MPEG-TS pousa no meio de um GOP,
+// MP4 com frames B pousa no keyframe seguinte ao alvo): o pouso é
+// conferido, e se não servir vêm a bissecção e, por fim, o começo do
+// arquivo, de onde a decodificação linear sempre chega.
+bool VideoFile::seek_to(int64_t ts, int64_t pos, int64_t want)
+{
+    bool ok;
+    // Sem índice, onde o seek por timestamp cai no meio de GOPs (TS/PS),
+    // bissecciona direto.
+    if (!index_ && can_bisect())
+        ok = bisect(ts);
+    else if (pos >= 0 && !ts_seek_reliable() &&
+             !(fmt_->iformat->flags & AVFMT_NO_BYTE_SEEK))
+        ok = seek_demuxer(pos, AVSEEK_FLAG_BYTE);
+    else
+        ok = seek_demuxer(ts, AVSEEK_FLAG_BACKWARD);
+    if (ok && land(ts, want)) return true;
+    if (can_bisect() && bisect(want) && landed(want)) return true;
+    return rewind();
+}
+
+// Onde o seek por timestamp é confiável, recua até três vezes para antes
+// do pacote em que caiu; em TS/PS repetir o mesmo seek não adianta.
+bool VideoFile::land(int64_t ts, int64_t want)
+{
+    for (int back = 0;; ++back) {
+        if (landed(want)) return true;
+        if (!held_ || back == 3 || !ts_seek_reliable()) return false;
+        int64_t at = pkt_->dts != AV_NOPTS_VALUE ? pkt_->dts : pkt_->pts;
+        if (pkt_->pts != AV_NOPTS_VALUE) at = std::min(at, pkt_->pts);
+        if (at == AV_NOPTS_VALUE) return false;
+        ts = std::min(ts, at) - 1;
+        if (!seek_demuxer(ts, AVSEEK_FLAG_BACKWARD)) return false;
+    }
+}
+
+// O primeiro pacote depois do seek é um keyframe com pts <= want? Ele fica
+// guardado em pkt_ para o próximo demux().
+bool VideoFile::landed(int64_t want)
+{
+    if (!demux(pkt_)) return false;
+    held_ = true;
+    return (pkt_->flags & AV_PKT_FLAG_KEY) && pkt_->pts != AV_NOPTS_VALUE &&
+           pkt_->pts <= want;
+}
+
+bool VideoFile::rewind()
+{
+    if (ts_seek_reliable() || (fmt_->iformat->flags & AVFMT_NO_BYTE_SEEK))
+        return seek_demuxer(start_, AVSEEK_FLAG_BACKWARD);
+    return seek_demuxer(0, AVSEEK_FLAG_BYTE);
+}
+
+// Todo seek do demuxer passa por aqui: descarta o pacote guardado.
+bool VideoFile::seek_demuxer(int64_t ts, int flags)
+{
+    if (held_) av_packet_unref(pkt_);
+    held_ = false;
+    return av_seek_frame(fmt_, stream_index_, ts, flags) >= 0;
+}
+
+// Contêineres com timestamps descontínuos (MPEG-TS/PS) ou índice genérico
+// (streams crus) buscam por timestamp às cegas.
+bool VideoFile::ts_seek_reliable() const
+{
+    return !(fmt_->iformat->flags & (AVFMT_TS_DISCONT | AVFMT_GENERIC_INDEX));
+}
+
+void VideoFile::close()
+{
+    if (pkt_)   av_packet_free(&pkt_);
+    if (frame_) av_frame_free(&frame_);
+    if (codec_ctx_) avcodec_free_context(&codec_ctx_);
+    if (fmt_)   avformat_close_input(&fmt_);
+    input_.reset();               // depois do fmt_, que usava o seu AVIOContext
+    has_frame_ = false;
+    held_ = false;
+}
+
+// Com entrada própria, pede os bytes do keyframe até o alvo (posições do
+// índice) e uma folga para o resto do GOP.
+void VideoFile::prefetch(std::size_t key, std::size_t n) const
+{
+    if (!input_ || !index_) return;
+    const int64_t from = (*index_)[key].pos, to = (*index_)[n].pos;
+    if (from < 0) return;
+    const std::size_t slack = 1 << 20;
+    input_->will_need(from, (to > from ? static_cast<std::size_t>(to - from) : 0) + slack);
+}
+
+// Só em contêineres com timestamps descontínuos (TS/PS): em Matroska e
+// MP4 um offset qualquer não cai no começo de um pacote, e o seek por
+// timestamp já é confiável.
+bool VideoFile::can_bisect() const
+{
+    return fmt_->pb && (fmt_->pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+           (fmt_->iformat->flags & AVFMT_TS_DISCONT) &&
+           !(fmt_->iformat->flags & AVFMT_NO_BYTE_SEEK) && avio_size(fmt_->pb) > 0;
+}
+
+// [lo, hi) é o trecho ainda não sondado depois do melhor keyframe achado.
+// Uma sonda cujo keyframe passa do alvo (ou nem aparece antes de hi) corta
+// a metade de cima; senão esse keyframe vira o melhor e a busca segue
+// depois dele. Termina quando o trecho cabe numa leitura de GOP. Um
+// keyframe sem pts (stream elementar cru: os pts são sintetizados pela
+// contagem desde o início) encerra a busca no começo do arquivo.
+bool VideoFile::bisect(int64_t ts)
+{
+    const int64_t min_span = 256 * 1024;
+    int64_t best = 0;             // sem keyframe <= alvo: início do arquivo
+    int64_t lo = 0, hi = avio_size(fmt_->pb);
+    for (int probes = 0; hi - lo > min_span && probes < 64; ++probes) {
+        int64_t mid = lo + (hi - lo) / 2;
+        int64_t pos, pts;
+        if (!probe_key(mid, hi, pos, pts)) {
+            hi = mid;
+        } else if (pts == AV_NOPTS_VALUE) {
+            best = 0;
+            break;
+        } else if (pts <= ts) {
+            best = pos;
+            lo = pos + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return seek_demuxer(best, AVSEEK_FLAG_BYTE);
+}
+
+// Primeiro keyframe do stream em [from, limit) do arquivo, lendo no
+// máximo probe_budget bytes: um GOP maior que isso conta como ausente,
+// o que só faz a bissecção começar um keyframe antes.
+bool VideoFile::probe_key(int64_t from, int64_t limit, int64_t& pos, int64_t& pts)
+{
+    const int64_t probe_budget = 16 << 20;
+    limit = std::min(limit, from + probe_budget);
+    if (!seek_demuxer(from, AVSEEK_FLAG_BYTE))
+        return false;
+    while (demux(pkt_)) {
+        const bool past = pkt_->pos >= limit;
+        const bool key = (pkt_->flags & AV_PKT_FLAG_KEY) && pkt_->pos >= from;
+        pos = pkt_->pos;
+        pts = pkt_->pts;
+        av_packet_unref(pkt_);
+        if (past) return false;
+        if (key) return true;
+    }
+    return false;
+}
+
+// Próximo pacote do stream de vídeo em pkt_; false em EOF ou erro.
+bool VideoFile::next_packet()
+{
+    return demux(pkt_);
+}
+
+bool VideoFile::demux(AVPacket* p)
+{
+    if (held_) {                  // pacote lido na conferência do seek
+        held_ = false;
+        if (p != pkt_) av_packet_move_ref(p, pkt_);
+        return true;
+    }
+    StageTimer t(stats_, &Stats::demux_ns);
+    while (av_read_frame(fmt_, p) >= 0) {
+        if (p->stream_index == stream_index_) {
+            bump(stats_, &Stats::packets);
+            bump(stats_, &Stats::bytes, static_cast<uint64_t>(p->size));
+            return true;
+        }
+        av_packet_unref(p);
+    }
+    return false;
+}
+
+bool VideoFile::demux_seek(std::size_t key)
+{
+    if (!index_ || key >= index_->size()) return false;
+    StageTimer t(stats_, &Stats::seek_ns);
+    bump(stats_, &Stats::seeks);
+    prefetch(key, key);
+    const IndexEntry& e = (*index_)[key];
+    return seek_to(e.pts, e.pos, e.pts);
+}
+
+bool VideoFile::send(const AVPacket* p)
+{
+    StageTimer t(stats_, &Stats::decode_ns);
+    if (p) bump(stats_, &Stats::packets_decoded);
+    if (p && fast_) discard_before_target(p);
+    return avcodec_send_packet(codec_ctx_, p) >= 0;
+}
+
+AVFrame* VideoFile::receive()
+{
+    {
+        StageTimer t(stats_, &Stats::decode_ns);
+        has_frame_ = avcodec_receive_frame(codec_ctx_, frame_) == 0;
+    }
+    if (!has_frame_) return nullptr;
+    count(frame_);
+    return frame_;
+}
+
+void VideoFile::flush()
+{
+    avcodec_flush_buffers(codec_ctx_);
+    resync_ = true;
+}
+
+bool VideoFile::pts_numbering() const
+{
+    if (index_ && index_->exact()) return true;
+    return rate_.num > 0 && rate_.den > 0;
+}
+
+std::size_t VideoFile::number_of(int64_t ts) const
+{
+    return index_ && index_->exact() ? index_->find(ts) : pts_to_frame(ts);
+}
+
+// Política de descarte por pacote (o pts do pacote é o do seu frame).
+// Pacotes sem pts são sempre decodificados por completo.
+void VideoFile::discard_before_target(const AVPacket* p)
+{
+    AVDiscard frame = AVDISCARD_DEFAULT;
+    if (p->pts != AV_NOPTS_VALUE && pts_numbering() && number_of(p->pts) < target_)
+        frame = AVDISCARD_NONREF;
+    codec_ctx_->skip_frame = frame;
+}
+
+int64_t VideoFile::frame_to_pts(std::size_t n) const
+{
+    return start_ + av_rescale_q(static_cast<int64_t>(n), av_inv_q(rate_), tb_);
+}
+
+std::size_t VideoFile::pts_to_frame(int64_t ts) const
+{
+    int64_t n = av_rescale_q_rnd(ts - start_, tb_, av_inv_q(rate_), AV_ROUND_NEAR_INF);
+    return n < 0 ? 0 : static_cast<std::size_t>(n);
+}
+
+// Numera o frame recém-decodificado: pelo índice exato, se houver; senão
+// contagem simples, ou pelo pts quando a posição foi perdida num seek,
+// quando o avanço rápido pode ter descartado frames ou com índice
+// estimado.
+void VideoFile::count(const AVFrame* fr)
+{
+    bump(stats_, &Stats::frames_decoded);
+    int64_t ts = fr->best_effort_timestamp;
+    if (index_ && index_->exact() && ts != AV_NOPTS_VALUE) {
+        pos_ = index_->find(ts);
+        resync_ = false;
+    } else if ((resync_ || fast_ || index_) && ts != AV_NOPTS_VALUE &&
+               pts_numbering()) {
+        pos_ = pts_to_frame(ts);
+        resync_ = false;
+    } else {
+        pos_ = next_;
+    }
+    next_ = pos_ + 1;
+}
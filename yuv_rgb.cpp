@@ -0,0 +1,285 @@
+/*
+ *  YUV 4:2:0 de 8 bits (YUV420P, YUVJ420P, NV12) -> RGB24, BT.601, com
+ *  kernels AVX2 e SSE4.1 escolhidos pela CPU e um laço escalar de reserva.
+ *
+ *  Toda a aritmética é de 16 bits em ponto fixo, no formato do pmulhrsw:
+ *  (a * b + 2^14) >> 15, com somas saturadas. O laço escalar reproduz as
+ *  mesmas operações, então os três kernels dão bytes idênticos.
+ */
+
+#include "get_frame.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GF_X86 1
+#endif
+
+namespace {
+
+// Coeficientes em Q13 (croma) e Q14 (luma); entradas deslocadas para que
+// todo produto saia com 6 bits de fração.
+struct Coeffs {
+    int16_t y_off;   // 16 (limitado) ou 0 (cheio)
+    int16_t y;       // ganho da luma, Q14, sobre (Y - y_off) << 7
+    int16_t rv;      // Q13, sobre (V - 128) << 8
+    int16_t gu;
+    int16_t gv;
+    int16_t bu;
+};
+
+constexpr Coeffs limited{16, 19071, 13074, 3209, 6660, 16531};   // 1.164 1.596 .392 .813 2.018
+constexpr Coeffs full{0, 16384, 11485, 2819, 5850, 14516};       // 1     1.402 .344 .714 1.772
+
+struct Planes {
+    const uint8_t* y;
+    const uint8_t* u;             // NV12: UV intercalado
+    const uint8_t* v;             // NV12: nullptr
+};
+
+/* ---------- Escalar ---------- */
+
+inline int16_t mulhrs(int16_t a, int16_t b)
+{
+    return static_cast<int16_t>((int32_t(a) * b + (1 << 14)) >> 15);
+}
+
+inline int16_t adds(int32_t a, int32_t b)
+{
+    int32_t s = a + b;
+    return static_cast<int16_t>(s > 32767 ? 32767 : s < -32768 ? -32768 : s);
+}
+
+inline uint8_t to_u8(int16_t v)
+{
+    int s = adds(v, 32) >> 6;
+    return static_cast<uint8_t>(s < 0 ? 0 : s > 255 ? 255 : s);
+}
+
+inline void pixel(const Coeffs& c, int Y, int U, int V, uint8_t* d)
+{
+    int16_t y = mulhrs(static_cast<int16_t>((Y - c.y_off) * 128), c.y);
+    int16_t u = static_cast<int16_t>((U - 128) * 256);
+    int16_t v = static_cast<int16_t>((V - 128) * 256);
+    d[0] = to_u8(adds(y, mulhrs(v, c.rv)));
+    d[1] = to_u8(adds(adds(y, -mulhrs(u, c.gu)), -mulhrs(v, c.gv)));
+    d[2] = to_u8(adds(y, mulhrs(u, c.bu)));
+}
+
+// Pixels [x, w) de uma linha.
+void row_scalar(const Coeffs& c, const Planes& p, int x, int w, uint8_t* dst)
+{
+    for (; x < w; ++x) {
+        int U, V;
+        if (p.v) {
+            U = p.u[x >> 1];
+            V = p.v[x >> 1];
+        } else {
+            U = p.u[x & ~1];
+            V = p.u[(x & ~1) + 1];
+        }
+        pixel(c, p.y[x], U, V, dst + 3 * x);
+    }
+}
+
+#ifdef GF_X86
+
+/* ---------- SSE4.1 ---------- */
+
+// Máscaras de pshufb que espalham R, G e B de 16 pixels em 48 bytes.
+struct Interleave {
+    __m128i m[3][3];              // [registro de saída][canal]
+};
+
+__attribute__((target("sse4.1")))
+Interleave interleave_masks()
+{
+    Interleave t;
+    for (int j = 0; j < 3; ++j)
+        for (int ch = 0; ch < 3; ++ch) {
+            alignas(16) int8_t b[16];
+            for (int i = 0; i < 16; ++i) {
+                int k = 16 * j + i;
+                b[i] = k % 3 == ch ? static_cast<int8_t>(k / 3) : int8_t(-128);
+            }
+            t.m[j][ch] = _mm_load_si128(reinterpret_cast<const __m128i*>(b));
+        }
+    return t;
+}
+
+__attribute__((target("sse4.1")))
+inline void store_rgb(const Interleave& t, __m128i r, __m128i g, __m128i b,
+                      uint8_t* dst)
+{
+    for (int j = 0; j < 3; ++j) {
+        __m128i o = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, t.m[j][0]),
+                                              _mm_shuffle_epi8(g, t.m[j][1])),
+                                 _mm_shuffle_epi8(b, t.m[j][2]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16 * j), o);
+    }
+}
+
+// Croma de 16 pixels, cada amostra repetida duas vezes.
+__attribute__((target("sse4.1")))
+inline void load_chroma(const Planes& p, int x, __m128i& u, __m128i& v)
+{
+    if (p.v) {
+        __m128i a = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p.u + x / 2));
+        __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p.v + x / 2));
+        u = _mm_unpacklo_epi8(a, a);
+        v = _mm_unpacklo_epi8(b, b);
+    } else {
+        __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.u + x));
+        u = _mm_shuffle_epi8(uv, _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6,
+                                               8, 8, 10, 10, 12, 12, 14, 14));
+        v = _mm_shuffle_epi8(uv, _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7,
+                                               9, 9, 11, 11, 13, 13, 15, 15));
+    }
+}
+
+// Oito pixels em 16 bits: y, u e v já expandidos de bytes.
+__attribute__((target("sse4.1")))
+inline void rgb8(const Coeffs& c, __m128i y, __m128i u, __m128i v,
+                 __m128i& r, __m128i& g, __m128i& b)
+{
+    const __m128i round = _mm_set1_epi16(32);
+    y = _mm_mulhrs_epi16(_mm_slli_epi16(_mm_sub_epi16(y, _mm_set1_epi16(c.y_off)), 7),
+                         _mm_set1_epi16(c.y));
+    u = _mm_slli_epi16(_mm_sub_epi16(u, _mm_set1_epi16(128)), 8);
+    v = _mm_slli_epi16(_mm_sub_epi16(v, _mm_set1_epi16(128)), 8);
+    r = _mm_adds_epi16(y, _mm_mulhrs_epi16(v, _mm_set1_epi16(c.rv)));
+    g = _mm_subs_epi16(_mm_subs_epi16(y, _mm_mulhrs_epi16(u, _mm_set1_epi16(c.gu))),
+                       _mm_mulhrs_epi16(v, _mm_set1_epi16(c.gv)));
+    b = _mm_adds_epi16(y, _mm_mulhrs_epi16(u, _mm_set1_epi16(c.bu)));
+    r = _mm_srai_epi16(_mm_adds_epi16(r, round), 6);
+    g = _mm_srai_epi16(_mm_adds_epi16(g, round), 6);
+    b = _mm_srai_epi16(_mm_adds_epi16(b, round), 6);
+}
+
+__attribute__((target("sse4.1")))
+void row_sse41(const Coeffs& c, const Interleave& t, const Planes& p, int w,
+               uint8_t* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.y + x));
+        __m128i u, v;
+        load_chroma(p, x, u, v);
+        __m128i r0, g0, b0, r1, g1, b1;
+        rgb8(c, _mm_unpacklo_epi8(y, zero), _mm_unpacklo_epi8(u, zero),
+             _mm_unpacklo_epi8(v, zero), r0, g0, b0);
+        rgb8(c, _mm_unpackhi_epi8(y, zero), _mm_unpackhi_epi8(u, zero),
+             _mm_unpackhi_epi8(v, zero), r1, g1, b1);
+        store_rgb(t, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1),
+                  _mm_packus_epi16(b0, b1), dst + 3 * x);
+    }
+    row_scalar(c, p, x, w, dst);
+}
+
+/* ---------- AVX2 ---------- */
+
+// Mesma conta do rgb8, dezesseis pixels por registro.
+__attribute__((target("avx2")))
+inline __m128i rgb16(const Coeffs& c, __m256i y, __m256i u, __m256i v, int ch)
+{
+    y = _mm256_mulhrs_epi16(
+        _mm256_slli_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(c.y_off)), 7),
+        _mm256_set1_epi16(c.y));
+    __m256i s;
+    if (ch == 0) {
+        s = _mm256_adds_epi16(y, _mm256_mulhrs_epi16(v, _mm256_set1_epi16(c.rv)));
+    } else if (ch == 1) {
+        s = _mm256_subs_epi16(
+            _mm256_subs_epi16(y, _mm256_mulhrs_epi16(u, _mm256_set1_epi16(c.gu))),
+            _mm256_mulhrs_epi16(v, _mm256_set1_epi16(c.gv)));
+    } else {
+        s = _mm256_adds_epi16(y, _mm256_mulhrs_epi16(u, _mm256_set1_epi16(c.bu)));
+    }
+    s = _mm256_srai_epi16(_mm256_adds_epi16(s, _mm256_set1_epi16(32)), 6);
+    return _mm_packus_epi16(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+}
+
+__attribute__((target("avx2")))
+void row_avx2(const Coeffs& c, const Interleave& t, const Planes& p, int w,
+              uint8_t* dst)
+{
+    const __m256i half = _mm256_set1_epi16(128);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m256i y = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.y + x)));
+        __m128i u8, v8;
+        load_chroma(p, x, u8, v8);
+        __m256i u = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(u8), half), 8);
+        __m256i v = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(v8), half), 8);
+        store_rgb(t, rgb16(c, y, u, v, 0), rgb16(c, y, u, v, 1), rgb16(c, y, u, v, 2),
+                  dst + 3 * x);
+    }
+    row_scalar(c, p, x, w, dst);
+}
+
+#endif // GF_X86
+
+} // namespace
+
+YuvKernel best_yuv_kernel()
+{
+#ifdef GF_X86
+    static const YuvKernel best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))   return YuvKernel::avx2;
+        if (__builtin_cpu_supports("sse4.1")) return YuvKernel::sse41;
+        return YuvKernel::scalar;
+    }();
+    return best;
+#else
+    return YuvKernel::scalar;
+#endif
+}
+
+const char* yuv_kernel_name(YuvKernel k)
+{
+    switch (k) {
+    case YuvKernel::avx2:  return "avx2";
+    case YuvKernel::sse41: return "sse4.1";
+    default:               return "scalar";
+    }
+}
+
+bool yuv_to_rgb24(const AVFrame* fr, uint8_t* dst, int dst_stride, YuvKernel k)
+{
+    const bool nv12 = fr->format == AV_PIX_FMT_NV12;
+    if (!nv12 && fr->format != AV_PIX_FMT_YUV420P && fr->format != AV_PIX_FMT_YUVJ420P)
+        return false;
+    const Coeffs& c = fr->format == AV_PIX_FMT_YUVJ420P ||
+                      fr->color_range == AVCOL_RANGE_JPEG ? full : limited;
+#ifdef GF_X86
+    if (k == YuvKernel::avx2 && best_yuv_kernel() != YuvKernel::avx2)
+        k = best_yuv_kernel();    // pedido acima do que a CPU tem
+    if (k == YuvKernel::sse41 && best_yuv_kernel() == YuvKernel::scalar)
+        k = YuvKernel::scalar;
+    static const Interleave masks =
+        best_yuv_kernel() == YuvKernel::scalar ? Interleave{} : interleave_masks();
+#else
+    k = YuvKernel::scalar;
+#endif
+
+    for (int y = 0; y < fr->height; ++y) {
+        const int cy = y >> 1;
+        Planes p{fr->data[0] + static_cast<std::ptrdiff_t>(y) * fr->linesize[0],
+                 fr->data[1] + static_cast<std::ptrdiff_t>(cy) * fr->linesize[1],
+                 nv12 ? nullptr
+                      : fr->data[2] + static_cast<std::ptrdiff_t>(cy) * fr->linesize[2]};
+        uint8_t* d = dst + static_cast<std::ptrdiff_t>(y) * dst_stride;
+        switch (k) {
+#ifdef GF_X86
+        case YuvKernel::avx2:  row_avx2(c, masks, p, fr->width, d);  break;
+        case YuvKernel::sse41: row_sse41(c, masks, p, fr->width, d); break;
+#endif
+        default:               row_scalar(c, p, 0, fr->width, d);    break;
+        }
+    }
+    return true;
+}